@@ -0,0 +1,169 @@
+#include "allocationTracker.hpp"
+
+#include <algorithm>
+#include <new>
+
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// NOLINTBEGIN
+namespace
+{
+// Plain counters without constructors, so they are usable before any static initialization ran
+constinit thread_local AllocationTracker::Counts threadCounts;
+
+void* allocate(std::size_t size, std::size_t alignment) noexcept
+{
+    threadCounts.allocations++;
+    threadCounts.bytes += size;
+
+    // operator new returns a unique pointer even for 0 bytes, aligned_alloc needs a multiple of the alignment
+    size = std::max<std::size_t>(size, 1);
+    if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        return std::malloc(size);
+
+#ifdef _WIN32
+    // MSVC has no aligned_alloc
+    return _aligned_malloc(size, alignment);
+#else
+    return std::aligned_alloc(alignment, ((size + alignment - 1) / alignment) * alignment);
+#endif
+}
+
+// Releases memory of allocate with the same alignment
+void deallocate(void* memory, std::size_t alignment) noexcept
+{
+#ifdef _WIN32
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+    {
+        _aligned_free(memory);
+        return;
+    }
+#else
+    // aligned_alloc memory is released with free as well
+    (void)alignment;
+#endif
+    std::free(memory);
+}
+
+void* allocateOrThrow(std::size_t size, std::size_t alignment)
+{
+    void* memory = allocate(size, alignment);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+
+    return memory;
+}
+} // namespace
+
+namespace AllocationTracker
+{
+Counts thread()
+{
+    return threadCounts;
+}
+} // namespace AllocationTracker
+
+void* operator new(std::size_t size)
+{
+    return allocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new[](std::size_t size)
+{
+    return allocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* memory) noexcept
+{
+    deallocate(memory, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    deallocate(memory, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    deallocate(memory, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+    deallocate(memory, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete(void* memory, std::align_val_t alignment) noexcept
+{
+    deallocate(memory, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void* memory, std::align_val_t alignment) noexcept
+{
+    deallocate(memory, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t alignment) noexcept
+{
+    deallocate(memory, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t alignment) noexcept
+{
+    deallocate(memory, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+    deallocate(memory, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+    deallocate(memory, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void operator delete(void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    deallocate(memory, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    deallocate(memory, static_cast<std::size_t>(alignment));
+}
+// NOLINTEND
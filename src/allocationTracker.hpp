@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+// Counts the heap allocations made through operator new, which this module replaces for the whole program. Every
+// thread counts its own, so measuring a frame or a tick is the difference of two readings on the same thread.
+// Allocations that bypass operator new, e.g. ImGui and Box2D calling malloc directly, are not counted.
+namespace AllocationTracker
+{
+struct Counts
+{
+    std::size_t allocations{};
+    std::size_t bytes{};
+
+    Counts operator-(const Counts& earlier) const
+    {
+        return {allocations - earlier.allocations, bytes - earlier.bytes};
+    }
+
+    Counts& operator+=(const Counts& other)
+    {
+        allocations += other.allocations;
+        bytes += other.bytes;
+        return *this;
+    }
+};
+
+// Allocations made by the calling thread since it started
+Counts thread();
+} // namespace AllocationTracker
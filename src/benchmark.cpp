@@ -0,0 +1,1257 @@
+#include "allocationTracker.hpp"
+#include "box2d/b2_body.h"
+#include "box2d/b2_fixture.h"
+#include "box2d/b2_polygon_shape.h"
+#include "box2d/b2_world.h"
+#include "gameClient.hpp"
+#include "gameServer.hpp"
+#include "levelBinary.hpp"
+#include "levelParser.hpp"
+#include "log.hpp"
+#include "matchRunner.hpp"
+#include "nlohmann/json.hpp"
+#include "profiler.hpp"
+#include "replay.hpp"
+#include "shipSystem.hpp"
+#include "simulation.hpp"
+#include "tileDecoder.hpp"
+
+#include <zlib.h>
+#ifdef LUMIAX_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <print>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+struct Options
+{
+    std::filesystem::path level{"../../data/levels/level1.json"};
+    bool levelGiven{};
+    int ships{16};
+    int ticks{6000};
+    std::optional<std::filesystem::path> replay;
+    // Matches > 0 runs that many independent simulations through MatchRunner
+    int matches{};
+    int threads{static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u))};
+    bool realtime{};
+    // Compares Ship::update against ShipSystem::update instead of running a level
+    bool shipController{};
+    // Compares the baked tile outlines against one body per solid tile
+    bool tileCollision{};
+    // Rollback > 0 repeatedly rewinds that many ticks and resimulates them
+    int rollback{};
+    // Runs a GameServer with synthetic clients over loopback
+    bool net{};
+    // Stream > 0 only keeps tile collision within that many meters of the ships
+    int stream{};
+    // Compares loading the tile layers of the level in the csv and the base64 encodings
+    bool encodings{};
+    // Measures TileDecoder on synthetic data, without parsing JSON
+    bool decode{};
+    // Measures the cost of a log call on the calling thread
+    bool log{};
+    // Destroy > 0 clears that many solid tiles per second next to the ships, like ships blasting through walls
+    int destroy{};
+    // Profiler zones of the run are written there as a Chrome trace
+    std::optional<std::filesystem::path> trace;
+};
+
+bool parseInt(std::string_view text, int& value)
+{
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc{} && ptr == text.data() + text.size() && value > 0;
+}
+
+std::optional<Options> parseOptions(std::span<char*> args)
+{
+    Options options;
+
+    for (std::size_t i = 1; i < args.size(); i++)
+    {
+        std::string_view name(args[i]);
+
+        if (name == "--realtime")
+        {
+            options.realtime = true;
+            continue;
+        }
+        if (name == "--ship-controller")
+        {
+            options.shipController = true;
+            continue;
+        }
+        if (name == "--tile-collision")
+        {
+            options.tileCollision = true;
+            continue;
+        }
+        if (name == "--net")
+        {
+            options.net = true;
+            continue;
+        }
+        if (name == "--encodings")
+        {
+            options.encodings = true;
+            continue;
+        }
+        if (name == "--decode")
+        {
+            options.decode = true;
+            continue;
+        }
+        if (name == "--log")
+        {
+            options.log = true;
+            continue;
+        }
+
+        if (i + 1 >= args.size())
+            return std::nullopt;
+        std::string_view value(args[++i]);
+
+        if (name == "--level")
+        {
+            options.level = value;
+            options.levelGiven = true;
+        }
+        else if (name == "--trace")
+        {
+            options.trace = value;
+        }
+        else if (name == "--replay")
+            options.replay = value;
+        else if (name == "--ships" && parseInt(value, options.ships))
+            continue;
+        else if (name == "--ticks" && parseInt(value, options.ticks))
+            continue;
+        else if (name == "--matches" && parseInt(value, options.matches))
+            continue;
+        else if (name == "--threads" && parseInt(value, options.threads))
+            continue;
+        else if (name == "--rollback" && parseInt(value, options.rollback))
+            continue;
+        else if (name == "--stream" && parseInt(value, options.stream))
+            continue;
+        else if (name == "--destroy" && parseInt(value, options.destroy))
+            continue;
+        else
+            return std::nullopt;
+    }
+
+    return options;
+}
+
+// Clears the solid tile closest to position within radius tiles in every layer, false if there is none
+bool blastTile(Level& level, sf::Vector2f position, int radius, std::vector<const Level::Chunk*>& chunks)
+{
+    // Tile bodies are centered on their tile coordinate
+    sf::Vector2i center{static_cast<int>(std::round(position.x)), static_cast<int>(std::round(position.y))};
+    sf::IntRect area{center - sf::Vector2i{radius, radius}, {(2 * radius) + 1, (2 * radius) + 1}};
+
+    chunks.clear();
+    level.chunksIn(area, chunks);
+
+    std::optional<sf::Vector2i> closest;
+    int closestDistance = std::numeric_limits<int>::max();
+    for (const auto* chunk : chunks)
+    {
+        int endX = std::min(chunk->x + chunk->width, area.position.x + area.size.x);
+        int endY = std::min(chunk->y + chunk->height, area.position.y + area.size.y);
+        for (int y = std::max(chunk->y, area.position.y); y < endY; y++)
+        {
+            for (int x = std::max(chunk->x, area.position.x); x < endX; x++)
+            {
+                sf::Vector2i offset = sf::Vector2i{x, y} - center;
+                int distance = (offset.x * offset.x) + (offset.y * offset.y);
+                if (chunk->data()[(x - chunk->x) + ((y - chunk->y) * chunk->width)] != 0 && distance < closestDistance)
+                {
+                    closest = sf::Vector2i{x, y};
+                    closestDistance = distance;
+                }
+            }
+        }
+    }
+
+    if (!closest.has_value())
+        return false;
+
+    for (std::size_t layer = 0; layer < level.getTileLayers().size(); layer++)
+        level.setTile(static_cast<unsigned>(layer), closest->x, closest->y, 0);
+
+    return true;
+}
+
+// Deterministic pattern of forward thrust with alternating turns, shifted per ship
+ShipInput scriptedInput(u64 tick, std::size_t shipIndex)
+{
+    ShipInput input;
+    u64 phase = ((tick / 30) + shipIndex) % 4;
+
+    input.set(Ship::Direction::Up, phase != 3);
+    input.set(Ship::Direction::Down, phase == 3);
+    input.set(Ship::Direction::Left, phase == 0);
+    input.set(Ship::Direction::Right, phase == 2);
+
+    return input;
+}
+
+std::vector<ShipSpawn> scriptedSpawns(int count)
+{
+    std::vector<ShipSpawn> spawns;
+    for (int i = 0; i < count; i++)
+    {
+        sf::Vector2f position{5.f + (static_cast<float>(i % 16) * 1.5f), 10.f + (static_cast<float>(i / 16) * 2.f)};
+        spawns.push_back({sf::Color::Green, {1.f, 1.4f}, position, {}});
+    }
+    return spawns;
+}
+
+std::expected<Level, std::string> loadLevel(const std::filesystem::path& path)
+{
+    if (path.extension() == ".lvl")
+        return LevelBinary::fromFile(path);
+
+    return LevelParser::fromFile(path);
+}
+
+void report(std::string_view name, std::vector<std::chrono::nanoseconds>& samples)
+{
+    if (samples.empty())
+        return;
+
+    std::ranges::sort(samples);
+
+    auto percentile = [&](double p)
+    {
+        auto index = static_cast<std::size_t>(p * static_cast<double>(samples.size() - 1));
+        return samples[index].count();
+    };
+
+    std::println("{:<18} p50 {:>9} ns  p90 {:>9} ns  p99 {:>9} ns  max {:>9} ns",
+                 name,
+                 percentile(0.5),
+                 percentile(0.9),
+                 percentile(0.99),
+                 samples.back().count());
+}
+
+// Runs the same ships and input through per object Ship::update and through ShipSystem, each in its own world
+int runShipController(const Options& options)
+{
+    b2World perObjectWorld({0.f, 0.f});
+    b2World batchedWorld({0.f, 0.f});
+
+    std::vector<Ship> perObjectShips;
+    std::vector<Ship> batchedShips;
+    ShipSystem shipSystem;
+
+    for (const auto& spawn : scriptedSpawns(options.ships))
+    {
+        perObjectShips.push_back(createTriangleShip(perObjectWorld, spawn.color, spawn.size, spawn.position));
+        auto& ship = batchedShips.emplace_back(
+            createTriangleShip(batchedWorld, spawn.color, spawn.size, spawn.position));
+        shipSystem.add(&ship.body(), ship.linearThrusterAcceleration(), ship.angularThrusterAcceleration());
+    }
+
+    std::vector<std::chrono::nanoseconds> perObject;
+    std::vector<std::chrono::nanoseconds> batched;
+    perObject.reserve(static_cast<std::size_t>(options.ticks));
+    batched.reserve(static_cast<std::size_t>(options.ticks));
+
+    using Clock = std::chrono::steady_clock;
+    float timeStep = 1.f / 60.f;
+
+    for (int tick = 0; tick < options.ticks; tick++)
+    {
+        for (std::size_t shipIndex = 0; shipIndex < perObjectShips.size(); shipIndex++)
+        {
+            ShipInput input = scriptedInput(static_cast<u64>(tick), shipIndex);
+            for (auto dir : {Ship::Direction::Left, Ship::Direction::Up, Ship::Direction::Right, Ship::Direction::Down})
+                perObjectShips[shipIndex].thruster(dir, input.get(dir));
+            shipSystem.thrusters(static_cast<u32>(shipIndex), input.thrusters);
+        }
+
+        auto start = Clock::now();
+        for (auto& ship : perObjectShips)
+            ship.update();
+        auto middle = Clock::now();
+        shipSystem.update();
+        auto end = Clock::now();
+
+        perObject.push_back(middle - start);
+        batched.push_back(end - middle);
+
+        perObjectWorld.Step(timeStep, 8, 3);
+        batchedWorld.Step(timeStep, 8, 3);
+    }
+
+    std::size_t mismatches = 0;
+    for (std::size_t shipIndex = 0; shipIndex < perObjectShips.size(); shipIndex++)
+    {
+        const auto& a = perObjectShips[shipIndex].body();
+        const auto& b = batchedShips[shipIndex].body();
+        if (a.GetPosition().x != b.GetPosition().x || a.GetPosition().y != b.GetPosition().y ||
+            a.GetAngle() != b.GetAngle())
+            mismatches++;
+    }
+
+    auto sum = [](const std::vector<std::chrono::nanoseconds>& samples)
+    {
+        std::chrono::nanoseconds result{};
+        for (auto sample : samples)
+            result += sample;
+        return result;
+    };
+    auto perObjectTotal = sum(perObject);
+    auto batchedTotal = sum(batched);
+
+    double speedup = static_cast<double>(perObjectTotal.count()) /
+                     static_cast<double>(std::max<i64>(batchedTotal.count(), 1));
+
+    std::println("{} ships, {} ticks, ShipSystem speedup {:.2f}x", options.ships, options.ticks, speedup);
+
+    report("Ship::update", perObject);
+    report("ShipSystem", batched);
+
+    if (mismatches > 0)
+    {
+        std::println(std::cerr, "{} ships ended up in different states", mismatches);
+        return 1;
+    }
+
+    return 0;
+}
+
+// One static box per solid tile, how tile collision was registered before it was baked into chain outlines
+void createTileBodies(const Level& level, b2World& world)
+{
+    for (const auto& layer : level.getTileLayers())
+    {
+        for (const auto& chunk : layer)
+        {
+            auto tiles = chunk.data();
+            for (int y = 0; y < chunk.height; y++)
+            {
+                for (int x = 0; x < chunk.width; x++)
+                {
+                    if (tiles[x + (y * chunk.width)] == 0)
+                        continue;
+
+                    b2BodyDef bodyDef;
+                    bodyDef.type = b2_staticBody;
+                    bodyDef.position.Set(static_cast<float>(chunk.x + x), static_cast<float>(chunk.y + y));
+                    b2Body* body = world.CreateBody(&bodyDef);
+
+                    b2PolygonShape box;
+                    box.SetAsBox(0.5f, 0.5f);
+                    b2FixtureDef fixtureDef;
+                    fixtureDef.shape = &box;
+                    body->CreateFixture(&fixtureDef);
+                }
+            }
+        }
+    }
+}
+
+// Steps the same ships and input once with a body per solid tile and once with the baked outlines, the state
+// before and after tile collision was baked
+int runTileCollision(const Options& options, Level prototype)
+{
+    prototype.bakeCollision();
+    sf::Time fixedStep = sf::seconds(1.f / 60.f);
+    using Clock = std::chrono::steady_clock;
+
+    auto measure = [&](std::string_view name, bool perTileBodies)
+    {
+        b2World world({0.f, 0.f});
+        Level level = prototype.instance();
+        if (perTileBodies)
+        {
+            level.registerRectCollisions(world);
+            createTileBodies(level, world);
+        }
+        else
+        {
+            level.registerCollision(world);
+        }
+
+        std::vector<Ship> ships;
+        for (const auto& spawn : scriptedSpawns(options.ships))
+            ships.push_back(createTriangleShip(world, spawn.color, spawn.size, spawn.position, spawn.angle));
+
+        int fixtureCount = 0;
+        for (const b2Body* body = world.GetBodyList(); body != nullptr; body = body->GetNext())
+        {
+            for (const b2Fixture* fixture = body->GetFixtureList(); fixture != nullptr; fixture = fixture->GetNext())
+                fixtureCount++;
+        }
+        std::println("{}: {} bodies, {} fixtures, {} broadphase proxies",
+                     name,
+                     world.GetBodyCount(),
+                     fixtureCount,
+                     world.GetProxyCount());
+
+        std::vector<std::chrono::nanoseconds> steps;
+        steps.reserve(static_cast<std::size_t>(options.ticks));
+        std::chrono::nanoseconds total{};
+        for (int tick = 0; tick < options.ticks; tick++)
+        {
+            for (std::size_t shipIndex = 0; shipIndex < ships.size(); shipIndex++)
+            {
+                ShipInput input = scriptedInput(static_cast<u64>(tick), shipIndex);
+                for (auto dir :
+                     {Ship::Direction::Left, Ship::Direction::Up, Ship::Direction::Right, Ship::Direction::Down})
+                    ships[shipIndex].thruster(dir, input.get(dir));
+                ships[shipIndex].update();
+            }
+            level.updateAnimations(fixedStep * static_cast<i64>(tick + 1), fixedStep);
+
+            auto start = Clock::now();
+            world.Step(fixedStep.asSeconds(), 8, 3);
+            steps.push_back(Clock::now() - start);
+            total += steps.back();
+        }
+
+        report(name, steps);
+        return total;
+    };
+
+    auto before = measure("Body per tile", true);
+    auto after = measure("Baked outlines", false);
+
+    std::println("{} ships, {} ticks, b2World::Step speedup {:.2f}x",
+                 options.ships,
+                 options.ticks,
+                 static_cast<double>(before.count()) / static_cast<double>(std::max<i64>(after.count(), 1)));
+
+    return 0;
+}
+
+// Saves, simulates rollback ticks, restores and resimulates them, comparing the checksums of both runs
+int runRollback(const Options& options, Simulation& simulation)
+{
+    TickInput scripted;
+    scripted.ships.resize(simulation.ships().size());
+    auto stepScripted = [&]
+    {
+        for (std::size_t shipIndex = 0; shipIndex < scripted.ships.size(); shipIndex++)
+            scripted.ships[shipIndex] = scriptedInput(simulation.tick(), shipIndex);
+        simulation.step(scripted);
+    };
+
+    SimulationState state;
+    std::vector<std::chrono::nanoseconds> saves;
+    std::vector<std::chrono::nanoseconds> restores;
+    int diverged = 0;
+    int rollbacks = options.ticks / options.rollback;
+
+    using Clock = std::chrono::steady_clock;
+
+    for (int rollback = 0; rollback < rollbacks; rollback++)
+    {
+        auto start = Clock::now();
+        simulation.save(state);
+        saves.push_back(Clock::now() - start);
+
+        for (int tick = 0; tick < options.rollback; tick++)
+            stepScripted();
+        u64 expected = simulation.checksum();
+
+        start = Clock::now();
+        simulation.restore(state);
+        restores.push_back(Clock::now() - start);
+
+        for (int tick = 0; tick < options.rollback; tick++)
+            stepScripted();
+        if (simulation.checksum() != expected)
+            diverged++;
+    }
+
+    std::println("{} rollbacks of {} ticks, state of {} bytes ({} bodies, {} contacts)",
+                 rollbacks,
+                 options.rollback,
+                 state.sizeBytes(),
+                 state.bodyCount(),
+                 state.contactCount());
+    report("Save", saves);
+    report("Restore", restores);
+
+    if (diverged > 0)
+    {
+        std::println(std::cerr, "{} of {} resimulations diverged from the original run", diverged, rollbacks);
+        return 1;
+    }
+
+    return 0;
+}
+
+std::string encodeBase64(std::span<const u8> bytes)
+{
+    constexpr std::string_view alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string text;
+    text.reserve(((bytes.size() + 2) / 3) * 4);
+    for (std::size_t i = 0; i < bytes.size(); i += 3)
+    {
+        std::size_t count = std::min<std::size_t>(3, bytes.size() - i);
+        u32 bits = static_cast<u32>(bytes[i]) << 16;
+        if (count > 1)
+            bits |= static_cast<u32>(bytes[i + 1]) << 8;
+        if (count > 2)
+            bits |= bytes[i + 2];
+
+        text += alphabet[(bits >> 18) & 63u];
+        text += alphabet[(bits >> 12) & 63u];
+        text += count > 1 ? alphabet[(bits >> 6) & 63u] : '=';
+        text += count > 2 ? alphabet[bits & 63u] : '=';
+    }
+
+    return text;
+}
+
+// Value of the "compression" property Tiled writes
+std::string_view compressionName(TileDecoder::Compression compression)
+{
+    switch (compression)
+    {
+    case TileDecoder::Compression::None:
+        return "";
+    case TileDecoder::Compression::Zlib:
+        return "zlib";
+    case TileDecoder::Compression::Gzip:
+        return "gzip";
+    case TileDecoder::Compression::Zstd:
+        return "zstd";
+    }
+    return "";
+}
+
+// Compresses like Tiled does for the respective compression setting, None returns the bytes unchanged
+std::vector<u8> compressBytes(std::span<const u8> bytes, TileDecoder::Compression compression)
+{
+    if (compression == TileDecoder::Compression::None)
+        return {bytes.begin(), bytes.end()};
+
+#ifdef LUMIAX_HAS_ZSTD
+    if (compression == TileDecoder::Compression::Zstd)
+    {
+        std::vector<u8> result(ZSTD_compressBound(bytes.size()));
+        result.resize(ZSTD_compress(result.data(), result.size(), bytes.data(), bytes.size(), ZSTD_CLEVEL_DEFAULT));
+        return result;
+    }
+#endif
+
+    bool gzip = compression == TileDecoder::Compression::Gzip;
+    z_stream stream{};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, gzip ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY);
+
+    std::vector<u8> result(deflateBound(&stream, static_cast<uLong>(bytes.size())) + 32);
+    stream.next_in = const_cast<Bytef*>(bytes.data());
+    stream.avail_in = static_cast<uInt>(bytes.size());
+    stream.next_out = result.data();
+    stream.avail_out = static_cast<uInt>(result.size());
+    deflate(&stream, Z_FINISH);
+    result.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    return result;
+}
+
+// Rewrites the tile layers of the level in every encoding and times parsing the JSON text plus its layers
+int runEncodings(const Options& options)
+{
+    std::ifstream file(options.level);
+    if (!file.is_open())
+    {
+        std::println(std::cerr, "Could not open level file: {}", options.level.string());
+        return 1;
+    }
+    nlohmann::json source = nlohmann::json::parse(file);
+
+    struct Variant
+    {
+        std::string_view name;
+        std::optional<TileDecoder::Compression> compression;
+    };
+    std::vector<Variant> variants = {{"csv", std::nullopt},
+                                     {"base64", TileDecoder::Compression::None},
+                                     {"base64+zlib", TileDecoder::Compression::Zlib},
+                                     {"base64+gzip", TileDecoder::Compression::Gzip}};
+#ifdef LUMIAX_HAS_ZSTD
+    variants.push_back({"base64+zstd", TileDecoder::Compression::Zstd});
+#else
+    std::println("zstd is left out, this build has no zstd support");
+#endif
+
+    std::optional<Level> reference;
+    int iterations = std::max(options.ticks / 100, 1);
+    using Clock = std::chrono::steady_clock;
+
+    for (const auto& [name, compression] : variants)
+    {
+        nlohmann::json levelFile = source;
+        for (auto& layer : levelFile["layers"])
+        {
+            if (layer["type"] != "tilelayer" || !compression.has_value())
+                continue;
+
+            layer["encoding"] = "base64";
+            if (*compression == TileDecoder::Compression::None)
+                layer.erase("compression");
+            else
+                layer["compression"] = compressionName(*compression);
+
+            for (auto& chunk : layer["chunks"])
+            {
+                auto tiles = chunk["data"].get<std::vector<u32>>();
+                // Tiled stores tile ids little endian, which is what every platform we ship on uses natively
+                std::span<const u8> bytes(reinterpret_cast<const u8*>(tiles.data()), tiles.size() * sizeof(u32));
+
+                chunk["data"] = encodeBase64(compressBytes(bytes, *compression));
+            }
+        }
+        std::string text = levelFile.dump();
+
+        std::vector<std::chrono::nanoseconds> samples;
+        for (int iteration = 0; iteration < iterations; iteration++)
+        {
+            auto start = Clock::now();
+            auto parsed = nlohmann::json::parse(text);
+            Level level;
+            if (auto error = LevelParser::parseLayers(level, parsed); error.has_value())
+            {
+                std::println(std::cerr, "{}: {}", name, *error);
+                return 1;
+            }
+            // base64 chunks are only decoded on first access, which belongs to the cost of the encoding
+            for (const auto& layer : level.getTileLayers())
+            {
+                for (const auto& chunk : layer)
+                    chunk.data();
+            }
+            samples.push_back(Clock::now() - start);
+
+            if (!reference.has_value())
+            {
+                reference = std::move(level);
+            }
+            else if (iteration == 0)
+            {
+                const auto& expected = reference->getTileLayers();
+                const auto& actual = level.getTileLayers();
+                bool same = expected.size() == actual.size();
+                for (std::size_t layer = 0; same && layer < expected.size(); layer++)
+                {
+                    same = expected[layer].size() == actual[layer].size();
+                    for (std::size_t chunk = 0; same && chunk < expected[layer].size(); chunk++)
+                        same = std::ranges::equal(expected[layer][chunk].data(), actual[layer][chunk].data());
+                }
+
+                if (!same)
+                {
+                    std::println(std::cerr, "{}: tiles differ from the csv encoding", name);
+                    return 1;
+                }
+            }
+        }
+
+        std::println("{:<12} {:>9} bytes of JSON, {} loads", name, text.size(), iterations);
+        report(name, samples);
+    }
+
+    return 0;
+}
+
+// Throughput of TileDecoder::decodeBase64 on one chunk and on a large buffer, plus the time to decode one chunk with
+// each compression
+int runDecode(const Options& options)
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Tile like ids, mostly empty with a few dozen distinct gids, so compression behaves like on real levels
+    auto tileBytes = [](std::size_t tileCount)
+    {
+        std::vector<u32> tiles(tileCount);
+        u32 state = 2463534242u;
+        for (auto& tile : tiles)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            tile = state % 3 == 0 ? 1 + (state >> 8) % 40 : 0;
+        }
+        std::vector<u8> bytes(tiles.size() * sizeof(u32));
+        std::memcpy(bytes.data(), tiles.data(), bytes.size());
+        return bytes;
+    };
+
+    constexpr std::size_t chunkTiles = 16 * 16;
+    for (std::size_t size : {chunkTiles * sizeof(u32), std::size_t{16} << 20})
+    {
+        auto bytes = tileBytes(size / sizeof(u32));
+        std::string text = encodeBase64(bytes);
+        std::vector<u8> out(bytes.size());
+
+        // About a gigabyte of output per size
+        std::size_t iterations = std::max<std::size_t>((std::size_t{1} << 30) / size, 1);
+        auto start = Clock::now();
+        for (std::size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            if (TileDecoder::decodeBase64(text, out) != out.size())
+            {
+                std::println(std::cerr, "base64 decoding failed");
+                return 1;
+            }
+        }
+        std::chrono::duration<double> elapsed = Clock::now() - start;
+
+        if (out != bytes)
+        {
+            std::println(std::cerr, "base64 decoding produced different bytes");
+            return 1;
+        }
+
+        double seconds = elapsed.count();
+        std::println("base64 {:>9} bytes: {:.2f} GB/s of text, {:.2f} GB/s decoded, {:.0f} ns per call",
+                     bytes.size(),
+                     static_cast<double>(text.size() * iterations) / seconds / 1e9,
+                     static_cast<double>(bytes.size() * iterations) / seconds / 1e9,
+                     seconds * 1e9 / static_cast<double>(iterations));
+    }
+
+    std::vector<TileDecoder::Compression> compressions = {TileDecoder::Compression::None,
+                                                          TileDecoder::Compression::Zlib,
+                                                          TileDecoder::Compression::Gzip};
+#ifdef LUMIAX_HAS_ZSTD
+    compressions.push_back(TileDecoder::Compression::Zstd);
+#endif
+
+    auto bytes = tileBytes(chunkTiles);
+    std::vector<u32> tiles(chunkTiles);
+    std::vector<u8> scratch;
+    for (auto compression : compressions)
+    {
+        std::string text = encodeBase64(compressBytes(bytes, compression));
+        std::vector<std::chrono::nanoseconds> samples;
+        samples.reserve(static_cast<std::size_t>(options.ticks));
+        for (int iteration = 0; iteration < options.ticks; iteration++)
+        {
+            auto start = Clock::now();
+            auto error = TileDecoder::decode(text, compression, tiles, scratch);
+            samples.push_back(Clock::now() - start);
+            if (error.has_value())
+            {
+                std::println(std::cerr, "{}", *error);
+                return 1;
+            }
+        }
+
+        auto name = compression == TileDecoder::Compression::None ? std::string_view{"chunk base64"}
+                                                                  : compressionName(compression);
+        std::println("{:<12} {:>5} bytes of base64 per 16x16 chunk", name, text.size());
+        report(name, samples);
+    }
+
+    return 0;
+}
+
+// Time a log call takes on the calling thread, for a written message and for one below the minimum severity. The
+// message is identical every time, so the writer collapses it into a few repeat summaries.
+int runLog(const Options& options)
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Calls are timed in batches, a single call takes about as long as reading the clock. Batches stay below the
+    // ring capacity and the writer drains the ring between them, so no message is dropped.
+    constexpr int batchSize = static_cast<int>(Log::ringCapacity / 2);
+    auto measure = [&](auto&& log)
+    {
+        std::vector<std::chrono::nanoseconds> samples;
+        samples.reserve(static_cast<std::size_t>(options.ticks / batchSize) + 1);
+        for (int calls = 0; calls < options.ticks; calls += batchSize)
+        {
+            auto start = Clock::now();
+            for (int call = 0; call < batchSize; call++)
+                log();
+            samples.push_back((Clock::now() - start) / batchSize);
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return samples;
+    };
+
+    Log::setMinimumSeverity(Log::Severity::Info);
+    u32 ship = 3;
+    float speed = 12.5f;
+    auto written = measure([&] { Log::info("Benchmark", "Ship {} at {:.2f} m/s", ship, speed); });
+    auto filtered = measure([&] { Log::debug("Benchmark", "Ship {} at {:.2f} m/s", ship, speed); });
+
+    std::println("{} calls each, per call averaged over batches of {}", options.ticks, batchSize);
+    report("Log written", written);
+    report("Log filtered", filtered);
+
+    return 0;
+}
+
+// Server with synthetic clients sending scripted input over loopback, at 2, 16 and 64 players
+int runNetLoad(const Options& options, Level prototype)
+{
+    sf::Time fixedStep = sf::seconds(1.f / 60.f);
+    prototype.bakeCollision();
+
+    for (std::size_t players : {2, 16, 64})
+    {
+        Simulation simulation(prototype.instance(), fixedStep);
+        auto server = GameServer::bind(simulation, sf::Socket::AnyPort);
+        if (!server.has_value())
+        {
+            std::println(std::cerr, "{}", server.error());
+            return 1;
+        }
+
+        std::vector<GameClient> clients;
+        for (std::size_t i = 0; i < players; i++)
+        {
+            auto client = GameClient::connect(sf::IpAddress::LocalHost, server->port());
+            if (!client.has_value())
+            {
+                std::println(std::cerr, "{}", client.error());
+                return 1;
+            }
+            clients.push_back(std::move(client.value()));
+        }
+
+        auto allJoined = [&]
+        { return std::ranges::all_of(clients, [](const GameClient& client) { return client.ship().has_value(); }); };
+        for (int attempt = 0; attempt < 100 && !allJoined(); attempt++)
+        {
+            server->tick();
+            for (auto& client : clients)
+            {
+                client.receive();
+                client.input(0);
+            }
+        }
+        if (!allJoined())
+        {
+            std::println(std::cerr, "Not all {} clients could join", players);
+            return 1;
+        }
+
+        std::vector<u64> bytesBefore(players);
+        for (std::size_t i = 0; i < players; i++)
+            bytesBefore[i] = server->clientStats(i).bytesSent;
+
+        std::vector<std::chrono::nanoseconds> serverTicks;
+        serverTicks.reserve(static_cast<std::size_t>(options.ticks));
+
+        for (int tick = 0; tick < options.ticks; tick++)
+        {
+            for (auto& client : clients)
+                client.input(scriptedInput(static_cast<u64>(tick), *client.ship()).thrusters);
+
+            serverTicks.push_back(server->tick());
+
+            for (auto& client : clients)
+                client.receive();
+        }
+
+        u64 bytesSent = 0;
+        u64 fullSnapshots = 0;
+        for (std::size_t i = 0; i < players; i++)
+        {
+            bytesSent += server->clientStats(i).bytesSent - bytesBefore[i];
+            fullSnapshots += server->clientStats(i).fullSnapshots;
+        }
+
+        double bytesPerTick = static_cast<double>(bytesSent) / static_cast<double>(players) / options.ticks;
+        std::println("{} players: {:.1f} bytes per client per tick, {:.1f} kbit/s per client at {:.0f} Hz, "
+                     "{} full snapshots",
+                     players,
+                     bytesPerTick,
+                     bytesPerTick * 8.0 / fixedStep.asSeconds() / 1000.0,
+                     1.0 / fixedStep.asSeconds(),
+                     fullSnapshots);
+        report("Server tick", serverTicks);
+    }
+
+    return 0;
+}
+
+// Steps independent matches of the scripted ships on the thread pool, as fast as possible or paced in real time
+int runMatches(const Options& options, Level level)
+{
+    sf::Time fixedStep = sf::seconds(1.f / 60.f);
+    MatchRunner runner(std::move(level),
+                       static_cast<std::size_t>(options.matches),
+                       scriptedSpawns(options.ships),
+                       fixedStep,
+                       static_cast<unsigned>(options.threads));
+
+    std::vector<std::chrono::nanoseconds> matchLatency;
+    std::vector<std::chrono::nanoseconds> tickWallTime;
+    matchLatency.reserve(static_cast<std::size_t>(options.ticks) * runner.matchCount());
+    tickWallTime.reserve(static_cast<std::size_t>(options.ticks));
+
+    int missedDeadlines = 0;
+    auto benchStart = std::chrono::steady_clock::now();
+    auto deadline = benchStart;
+
+    for (int tick = 0; tick < options.ticks; tick++)
+    {
+        for (std::size_t matchIndex = 0; matchIndex < runner.matchCount(); matchIndex++)
+        {
+            auto& input = runner.input(matchIndex);
+            for (std::size_t shipIndex = 0; shipIndex < input.ships.size(); shipIndex++)
+                input.ships[shipIndex] = scriptedInput(runner.match(matchIndex).tick(), shipIndex + matchIndex);
+        }
+
+        tickWallTime.push_back(runner.tick());
+        matchLatency.insert(matchLatency.end(), runner.latencies().begin(), runner.latencies().end());
+
+        if (options.realtime)
+        {
+            deadline += fixedStep.toDuration();
+            if (std::chrono::steady_clock::now() > deadline)
+                missedDeadlines++;
+            else
+                std::this_thread::sleep_until(deadline);
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - benchStart;
+
+    double busySeconds = 0.0;
+    for (auto latency : matchLatency)
+        busySeconds += std::chrono::duration<double>(latency).count();
+
+    auto matchTicks = static_cast<double>(matchLatency.size());
+    double tickRate = 1.0 / fixedStep.asSeconds();
+
+    std::println("{} matches with {} ships, {} ticks on {} threads in {:.3f} s",
+                 runner.matchCount(),
+                 options.ships,
+                 options.ticks,
+                 runner.threadCount(),
+                 elapsed.count());
+    std::println("{:.0f} match ticks/s, {:.1f} matches per core at {:.0f} Hz (by step time: {:.1f})",
+                 matchTicks / elapsed.count(),
+                 matchTicks / elapsed.count() / runner.threadCount() / tickRate,
+                 tickRate,
+                 matchTicks / busySeconds / tickRate);
+    if (options.realtime)
+        std::println("{} of {} ticks missed their deadline", missedDeadlines, options.ticks);
+
+    report("Match tick", matchLatency);
+    report("All matches", tickWallTime);
+
+    return 0;
+}
+
+// Everything but option parsing, so the trace is written whichever mode ran
+int run(Options& options)
+{
+    if (options.shipController)
+        return runShipController(options);
+
+    if (options.encodings)
+        return runEncodings(options);
+
+    if (options.decode)
+        return runDecode(options);
+
+    if (options.log)
+        return runLog(options);
+
+    // These modes script their own input, a recording would be ignored
+    if (options.replay.has_value() && (options.matches > 0 || options.rollback > 0 || options.destroy > 0))
+    {
+        std::println(std::cerr, "--replay cannot be combined with --matches, --rollback or --destroy");
+        return 1;
+    }
+
+    // Replays bring their own level, ships, tick rate and length
+    std::optional<Replay::Recording> recording;
+    if (options.replay.has_value())
+    {
+        auto recordingResult = Replay::fromFile(*options.replay);
+        if (!recordingResult.has_value())
+        {
+            std::println(std::cerr, "Failed to load recording: {}", recordingResult.error());
+            return 1;
+        }
+        recording = std::move(recordingResult.value());
+
+        if (!options.levelGiven)
+            options.level = recording->levelPath;
+        options.ships = static_cast<int>(recording->ships.size());
+        options.ticks = static_cast<int>(recording->tickCount);
+    }
+
+    auto levelResult = loadLevel(options.level);
+    if (!levelResult.has_value())
+    {
+        std::println(std::cerr, "Failed to load level: {}", levelResult.error());
+        return 1;
+    }
+
+    if (options.tileCollision)
+        return runTileCollision(options, std::move(levelResult.value()));
+
+    if (options.matches > 0)
+        return runMatches(options, std::move(levelResult.value()));
+
+    if (options.net)
+        return runNetLoad(options, std::move(levelResult.value()));
+
+    sf::Time fixedStep = recording.has_value() ? sf::microseconds(recording->fixedStepMicroseconds)
+                                               : sf::seconds(1.f / 60.f);
+    std::optional<ChunkStreamer::Settings> streaming;
+    if (options.stream > 0)
+    {
+        auto radius = static_cast<float>(options.stream);
+        streaming = ChunkStreamer::Settings{.loadRadius = radius, .unloadRadius = radius * 1.5f};
+    }
+    Simulation simulation(std::move(levelResult.value()), fixedStep, streaming);
+
+    if (recording.has_value())
+    {
+        for (const auto& spawn : recording->ships)
+            simulation.addShip(spawn.color, spawn.size, spawn.position, spawn.angle);
+    }
+    else
+    {
+        for (const auto& spawn : scriptedSpawns(options.ships))
+            simulation.addShip(spawn.color, spawn.size, spawn.position, spawn.angle);
+    }
+
+    int fixtureCount = 0;
+    int edgeCount = 0;
+    for (const b2Body* body = simulation.world().GetBodyList(); body != nullptr; body = body->GetNext())
+    {
+        for (const b2Fixture* fixture = body->GetFixtureList(); fixture != nullptr; fixture = fixture->GetNext())
+        {
+            fixtureCount++;
+            edgeCount += fixture->GetShape()->GetChildCount();
+        }
+    }
+
+    std::println("Level {}: {} bodies, {} fixtures, {} shape children, {} broadphase proxies",
+                 options.level.string(),
+                 simulation.world().GetBodyCount(),
+                 fixtureCount,
+                 edgeCount,
+                 simulation.world().GetProxyCount());
+
+    if (options.rollback > 0)
+        return runRollback(options, simulation);
+
+    std::vector<std::chrono::nanoseconds> tileCollision;
+    std::vector<std::chrono::nanoseconds> shipUpdate;
+    std::vector<std::chrono::nanoseconds> animations;
+    std::vector<std::chrono::nanoseconds> physics;
+    std::vector<std::chrono::nanoseconds> edits;
+    std::vector<std::chrono::nanoseconds> total;
+    tileCollision.reserve(static_cast<std::size_t>(options.ticks));
+    shipUpdate.reserve(static_cast<std::size_t>(options.ticks));
+    animations.reserve(static_cast<std::size_t>(options.ticks));
+    physics.reserve(static_cast<std::size_t>(options.ticks));
+    edits.reserve(static_cast<std::size_t>(options.ticks));
+    total.reserve(static_cast<std::size_t>(options.ticks));
+
+    TickInput scripted;
+    scripted.ships.resize(simulation.ships().size());
+    StepTimings timings;
+
+    std::optional<Replay::Player> player;
+    if (recording.has_value())
+        player.emplace(*recording);
+    std::optional<u64> divergedAt;
+
+    auto benchStart = std::chrono::steady_clock::now();
+    std::size_t peakLoadedRegions = 0;
+    i32 peakProxies = 0;
+
+    double destroyPerTick = options.destroy * fixedStep.asSeconds();
+    double destroyPending = 0.0;
+    std::size_t destroyed = 0;
+    std::size_t destroyMissed = 0;
+    std::vector<const Level::Chunk*> blastChunks;
+    int overBudget = 0;
+
+    // Buffers may still grow during the first second, afterwards a step should not allocate at all
+    int warmupTicks = static_cast<int>(std::lround(1.f / fixedStep.asSeconds()));
+    AllocationTracker::Counts warmupAllocations;
+    AllocationTracker::Counts steadyAllocations;
+    int allocatingTicks = 0;
+
+    for (int tick = 0; tick < options.ticks; tick++)
+    {
+        AllocationTracker::Counts stepAllocations;
+        std::chrono::nanoseconds edit{};
+        if (player.has_value())
+        {
+            const auto& recorded = player->next();
+            auto allocationsBefore = AllocationTracker::thread();
+            simulation.step(recorded, timings);
+            stepAllocations = AllocationTracker::thread() - allocationsBefore;
+
+            if (!divergedAt.has_value() && !player->verify(simulation))
+                divergedAt = simulation.tick();
+        }
+        else
+        {
+            for (std::size_t shipIndex = 0; shipIndex < scripted.ships.size(); shipIndex++)
+                scripted.ships[shipIndex] = scriptedInput(simulation.tick(), shipIndex);
+
+            // Edits land between ticks, the step repairs their collision as part of its tile collision phase.
+            // Both halves count against the tick budget, setTile included.
+            auto editStart = std::chrono::steady_clock::now();
+            for (destroyPending += destroyPerTick; destroyPending >= 1.0; destroyPending -= 1.0)
+            {
+                const auto& ship = simulation.ships()[(destroyed + destroyMissed) % simulation.ships().size()];
+                if (blastTile(simulation.level(), ship.position(), 8, blastChunks))
+                    destroyed++;
+                else
+                    destroyMissed++;
+            }
+            edit = std::chrono::steady_clock::now() - editStart;
+
+            auto allocationsBefore = AllocationTracker::thread();
+            simulation.step(scripted, timings);
+            stepAllocations = AllocationTracker::thread() - allocationsBefore;
+        }
+
+        if (tick < warmupTicks)
+        {
+            warmupAllocations += stepAllocations;
+        }
+        else
+        {
+            steadyAllocations += stepAllocations;
+            if (stepAllocations.allocations > 0)
+                allocatingTicks++;
+        }
+
+        tileCollision.push_back(timings.tileCollision);
+        shipUpdate.push_back(timings.shipUpdate);
+        animations.push_back(timings.animations);
+        physics.push_back(timings.physics);
+        edits.push_back(edit);
+        total.push_back(edit + timings.tileCollision + timings.shipUpdate + timings.animations + timings.physics);
+        if (total.back() > fixedStep.toDuration())
+            overBudget++;
+
+        if (const auto* streamer = simulation.chunkStreamer(); streamer != nullptr)
+        {
+            peakLoadedRegions = std::max(peakLoadedRegions, streamer->loadedRegions());
+            peakProxies = std::max(peakProxies, simulation.world().GetProxyCount());
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - benchStart;
+
+    std::println("{} ships, {} ticks in {:.3f} s ({:.0f} ticks/s)",
+                 options.ships,
+                 options.ticks,
+                 elapsed.count(),
+                 options.ticks / elapsed.count());
+
+    if (const auto* streamer = simulation.chunkStreamer(); streamer != nullptr)
+    {
+        std::println("Streaming {} m: peak {} of {} regions loaded, peak {} broadphase proxies, {} synchronous loads",
+                     options.stream,
+                     peakLoadedRegions,
+                     streamer->regionCount(),
+                     peakProxies,
+                     streamer->stalls());
+    }
+    if (simulation.chunkStreamer() != nullptr || destroyPerTick > 0.0)
+        report("Tile collision", tileCollision);
+    if (destroyPerTick > 0.0)
+    {
+        report("Tile edits", edits);
+        std::println("Destroyed {} tiles ({:.0f}/s), {} attempts found no tile near the ship, {} of {} ticks over the "
+                     "{:.2f} ms budget",
+                     destroyed,
+                     static_cast<double>(destroyed) / (options.ticks * fixedStep.asSeconds()),
+                     destroyMissed,
+                     overBudget,
+                     options.ticks,
+                     fixedStep.asSeconds() * 1000.f);
+    }
+    report("Ship::update", shipUpdate);
+    report("updateAnimations", animations);
+    report("b2World::Step", physics);
+    report("Total", total);
+    std::println("Allocations: {} ({} bytes) in the first {} ticks, {} ({} bytes) in {} of the remaining {} ticks",
+                 warmupAllocations.allocations,
+                 warmupAllocations.bytes,
+                 std::min(warmupTicks, options.ticks),
+                 steadyAllocations.allocations,
+                 steadyAllocations.bytes,
+                 allocatingTicks,
+                 std::max(options.ticks - warmupTicks, 0));
+
+    if (divergedAt.has_value())
+    {
+        std::println(std::cerr, "Replay diverged, first checksum mismatch at tick {}", *divergedAt);
+        return 1;
+    }
+
+    if (player.has_value())
+        std::println("Replay matched all {} checksums", recording->checksums.size());
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::span args(argv, static_cast<std::size_t>(argc));
+
+    auto options = parseOptions(args);
+    if (!options.has_value())
+    {
+        std::println(std::cerr,
+                     "Usage: {} [--level <level>] [--ships <count>] [--ticks <count>] [--replay <recording>] "
+                     "[--matches <count> [--threads <count>] [--realtime]] [--ship-controller] [--tile-collision] "
+                     "[--rollback <ticks>] [--net] [--stream <meters>] [--destroy <tiles per second>] [--encodings] "
+                     "[--decode] [--log] [--trace <file>]",
+                     args[0]);
+        return 1;
+    }
+
+    LUMIAX_THREAD_NAME("Benchmark");
+    int result = run(*options);
+
+    if (options->trace.has_value())
+    {
+        if (auto error = Profiler::writeChromeTrace(*options->trace); error.has_value())
+        {
+            std::println(std::cerr, "{}", *error);
+            return 1;
+        }
+        std::println("Wrote profiler trace to {}", options->trace->string());
+    }
+
+    return result;
+}
@@ -0,0 +1,230 @@
+#include "chunkStreamer.hpp"
+
+#include "box2d/b2_world.h"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <optional>
+
+ChunkStreamer::ChunkStreamer(const Level& level, Settings settings) :
+    mSettings{settings},
+    mRegions{CollisionBaker::regions(level.getTileLayers())},
+    mSlots(mRegions.size())
+{
+    for (std::size_t index = 0; index < mRegions.size(); index++)
+    {
+        const auto& region = mRegions[index];
+        mRegionGrid.insert(static_cast<u32>(index),
+                           {{static_cast<float>(region.x) - 0.5f, static_cast<float>(region.y) - 0.5f},
+                            {static_cast<float>(region.width), static_cast<float>(region.height)}});
+    }
+
+    mThread = std::jthread([this](const std::stop_token& stopToken) { run(stopToken); });
+}
+
+void ChunkStreamer::update(std::span<const sf::Vector2f> focusPoints, const Level& level, b2World& world)
+{
+    {
+        std::scoped_lock lock(mMutex);
+        std::swap(mBaked, mFinished);
+    }
+
+    // Results for regions that were unloaded or invalidated in the meantime are dropped
+    for (const auto& [region, generation, collision] : mFinished)
+    {
+        const auto& slot = mSlots[region];
+        if (slot.state == State::Requested && slot.generation == generation)
+            load(region, collision, world);
+    }
+    mFinished.clear();
+
+    for (std::size_t activeIndex = mActive.size(); activeIndex-- > 0;)
+    {
+        if (distance(mActive[activeIndex], focusPoints) > mSettings.unloadRadius)
+            unload(activeIndex, world);
+    }
+
+    mQueryResult.clear();
+    query(focusPoints, mSettings.loadRadius, mQueryResult);
+
+    bool requested = false;
+    for (u32 region : mQueryResult)
+    {
+        if (mSlots[region].state != State::Unloaded)
+            continue;
+
+        mSlots[region].state = State::Requested;
+        mActive.push_back(region);
+        request(region, level);
+        requested = true;
+    }
+    if (requested)
+        mWake.notify_one();
+
+    // Ships must never fly through tiles that did not arrive yet
+    mQueryResult.clear();
+    query(focusPoints, mSettings.requiredRadius, mQueryResult);
+
+    for (u32 region : mQueryResult)
+    {
+        if (mSlots[region].state == State::Loaded)
+            continue;
+
+        if (mSlots[region].state == State::Unloaded)
+            mActive.push_back(region);
+        else
+            cancelRequest(region);
+
+        const auto& bounds = mRegions[region];
+        load(region, CollisionBaker::bakeRegion(CollisionBaker::regionGrid(level, bounds), bounds), world);
+        mStalls++;
+    }
+}
+
+void ChunkStreamer::invalidate(std::span<const sf::IntRect> dirty, const Level& level, b2World& world)
+{
+    mQueryResult.clear();
+    for (const auto& rect : dirty)
+    {
+        // Region bounds in the grid are offset by half a tile like the bodies
+        auto reach = CollisionBaker::dirtyReach(rect);
+        mRegionGrid.query({sf::Vector2f(reach.position) - sf::Vector2f{0.5f, 0.5f}, sf::Vector2f(reach.size)},
+                          mQueryResult);
+    }
+    std::ranges::sort(mQueryResult);
+    mQueryResult.erase(std::ranges::unique(mQueryResult).begin(), mQueryResult.end());
+
+    bool requested = false;
+    for (u32 region : mQueryResult)
+    {
+        const auto& bounds = mRegions[region];
+        auto& slot = mSlots[region];
+        if (slot.state == State::Unloaded || !CollisionBaker::affects(dirty, bounds))
+            continue;
+
+        if (slot.state == State::Requested)
+        {
+            cancelRequest(region);
+            request(region, level);
+            requested = true;
+            continue;
+        }
+
+        slot.body = CollisionBaker::rebuildBody(world, slot.body, level, bounds, region);
+    }
+    if (requested)
+        mWake.notify_one();
+}
+
+void ChunkStreamer::unloadAll(b2World& world)
+{
+    for (std::size_t activeIndex = mActive.size(); activeIndex-- > 0;)
+        unload(activeIndex, world);
+}
+
+void ChunkStreamer::run(const std::stop_token& stopToken)
+{
+    LUMIAX_THREAD_NAME("Chunk loader");
+
+    while (true)
+    {
+        std::optional<Request> request;
+        {
+            std::unique_lock lock(mMutex);
+            if (!mWake.wait(lock, stopToken, [this] { return !mRequests.empty(); }))
+                return;
+
+            request.emplace(std::move(mRequests.front()));
+            mRequests.pop_front();
+        }
+
+        LUMIAX_ZONE("Bake region");
+        auto collision = CollisionBaker::bakeRegion(request->grid, mRegions[request->region]);
+
+        std::scoped_lock lock(mMutex);
+        mBaked.push_back({request->region, request->generation, std::move(collision)});
+    }
+}
+
+void ChunkStreamer::request(u32 region, const Level& level)
+{
+    // Copying the tiles here keeps the loader independent of later edits to the level
+    auto grid = CollisionBaker::regionGrid(level, mRegions[region]);
+
+    std::scoped_lock lock(mMutex);
+    mRequests.push_back({region, mSlots[region].generation, std::move(grid)});
+}
+
+void ChunkStreamer::cancelRequest(u32 region)
+{
+    // A bake that is already running is dropped by update once it arrives
+    mSlots[region].generation++;
+
+    std::scoped_lock lock(mMutex);
+    if (auto pending = std::ranges::find(mRequests, region, &Request::region); pending != mRequests.end())
+        mRequests.erase(pending);
+}
+
+void ChunkStreamer::load(u32 region, const CollisionBaker::RegionCollision& collision, b2World& world)
+{
+    auto& slot = mSlots[region];
+    slot.state = State::Loaded;
+    slot.body = collision.chains.empty() ? nullptr : CollisionBaker::createBody(world, collision, region);
+    mLoadedCount++;
+}
+
+void ChunkStreamer::unload(std::size_t activeIndex, b2World& world)
+{
+    u32 region = mActive[activeIndex];
+    mActive[activeIndex] = mActive.back();
+    mActive.pop_back();
+
+    auto& slot = mSlots[region];
+    if (slot.state == State::Requested)
+    {
+        cancelRequest(region);
+    }
+    else
+    {
+        if (slot.body != nullptr)
+            world.DestroyBody(slot.body);
+        mLoadedCount--;
+    }
+
+    slot.state = State::Unloaded;
+    slot.body = nullptr;
+}
+
+void ChunkStreamer::query(std::span<const sf::Vector2f> focusPoints, float radius, std::vector<u32>& result) const
+{
+    for (auto point : focusPoints)
+    {
+        auto begin = result.size();
+        mRegionGrid.query({point - sf::Vector2f{radius, radius}, {2.f * radius, 2.f * radius}}, result);
+
+        // The grid works on cells, drop the regions in the corners of the square
+        auto outOfRange = [&](u32 region) { return distance(region, {&point, 1}) > radius; };
+        result.erase(std::remove_if(result.begin() + static_cast<std::ptrdiff_t>(begin), result.end(), outOfRange),
+                     result.end());
+    }
+}
+
+float ChunkStreamer::distance(u32 region, std::span<const sf::Vector2f> focusPoints) const
+{
+    const auto& bounds = mRegions[region];
+    float left = static_cast<float>(bounds.x) - 0.5f;
+    float top = static_cast<float>(bounds.y) - 0.5f;
+    float right = left + static_cast<float>(bounds.width);
+    float bottom = top + static_cast<float>(bounds.height);
+
+    float closest = std::numeric_limits<float>::max();
+    for (auto point : focusPoints)
+    {
+        sf::Vector2f offset{std::max({left - point.x, 0.f, point.x - right}),
+                            std::max({top - point.y, 0.f, point.y - bottom})};
+        closest = std::min(closest, offset.length());
+    }
+
+    return closest;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "SFML/Graphics/Rect.hpp"
+#include "SFML/System/Vector2.hpp"
+#include "collisionBaker.hpp"
+#include "level.hpp"
+#include "spatialGrid.hpp"
+#include "types.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+class b2Body;
+class b2World;
+
+// Keeps tile collision only around a set of focus points, usually the ships. Regions are baked on a loader thread
+// and turned into bodies by update, so the world is only touched between ticks and its size depends on the active
+// area instead of the map. Requests carry a copy of the tiles around their region, the loader never reads the level.
+// Bodies belong to the world and outlive the streamer.
+class ChunkStreamer
+{
+public:
+    // Distances in meters from a focus point to the closest point of a region
+    struct Settings
+    {
+        // Regions closer than this are requested from the loader thread
+        float loadRadius{32.f};
+        // Regions further away than this are destroyed, larger than loadRadius to avoid thrashing at the border
+        float unloadRadius{48.f};
+        // Regions closer than this are baked on the calling thread if the loader did not deliver them in time
+        float requiredRadius{4.f};
+    };
+
+    // The chunk layout of level must stay the same for the lifetime of the streamer
+    ChunkStreamer(const Level& level, Settings settings);
+
+    ChunkStreamer(const ChunkStreamer&) = delete;
+    ChunkStreamer& operator=(const ChunkStreamer&) = delete;
+
+    // Creates bodies for regions the loader finished, destroys the ones out of range and requests new ones. Call
+    // between world steps.
+    void update(std::span<const sf::Vector2f> focusPoints, const Level& level, b2World& world);
+    // Rebakes loaded regions whose outlines depend on tiles within dirty and requests pending ones again
+    void invalidate(std::span<const sf::IntRect> dirty, const Level& level, b2World& world);
+    // Destroys all bodies and drops pending requests, update loads them again
+    void unloadAll(b2World& world);
+
+    const Settings& settings() const { return mSettings; }
+    std::size_t regionCount() const { return mRegions.size(); }
+    std::size_t loadedRegions() const { return mLoadedCount; }
+    // Regions baked synchronously because the loader fell behind
+    std::size_t stalls() const { return mStalls; }
+
+private:
+    enum class State : u8
+    {
+        Unloaded,
+        Requested,
+        Loaded
+    };
+
+    struct Slot
+    {
+        State state{State::Unloaded};
+        b2Body* body{};
+        // Incremented whenever a request of the slot becomes stale
+        u32 generation{};
+    };
+
+    struct Request
+    {
+        u32 region{};
+        u32 generation{};
+        CollisionBaker::TileGrid grid;
+    };
+
+    struct Baked
+    {
+        u32 region{};
+        u32 generation{};
+        CollisionBaker::RegionCollision collision;
+    };
+
+    void run(const std::stop_token& stopToken);
+    void request(u32 region, const Level& level);
+    void cancelRequest(u32 region);
+    void load(u32 region, const CollisionBaker::RegionCollision& collision, b2World& world);
+    void unload(std::size_t activeIndex, b2World& world);
+    // Appends regions within radius of any focus point, may contain duplicates
+    void query(std::span<const sf::Vector2f> focusPoints, float radius, std::vector<u32>& result) const;
+    float distance(u32 region, std::span<const sf::Vector2f> focusPoints) const;
+
+    Settings mSettings;
+    std::vector<CollisionBaker::Region> mRegions;
+    std::vector<Slot> mSlots;
+    SpatialGrid mRegionGrid{16.f};
+    // Regions that are requested or loaded
+    std::vector<u32> mActive;
+    std::vector<u32> mQueryResult;
+    std::size_t mLoadedCount{};
+    std::size_t mStalls{};
+
+    std::mutex mMutex;
+    std::condition_variable_any mWake;
+    std::deque<Request> mRequests;
+    std::vector<Baked> mBaked;
+    // Swapped with mBaked under the lock, so neither side allocates once both have grown
+    std::vector<Baked> mFinished;
+
+    // Last member, joined before the state it works on is destroyed
+    std::jthread mThread;
+};
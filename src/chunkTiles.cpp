@@ -0,0 +1,70 @@
+#include "chunkTiles.hpp"
+
+#include "log.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+ChunkTiles::ChunkTiles(std::vector<u32> tiles) : mCount{tiles.size()}, mTiles{std::move(tiles)}
+{
+    // Nothing left to decode
+    std::call_once(mDecoded, [] {});
+}
+
+ChunkTiles::ChunkTiles(std::size_t count, Decoder decoder) : mCount{count}, mDecoder{std::move(decoder)} {}
+
+ChunkTiles::ChunkTiles(const ChunkTiles& other) : mCount{other.mCount}
+{
+    auto tiles = other.get();
+    mTiles.assign(tiles.begin(), tiles.end());
+    mError = other.mError;
+    std::call_once(mDecoded, [] {});
+}
+
+std::span<const u32> ChunkTiles::get() const
+{
+    std::call_once(mDecoded, [this] { decode(); });
+    return mTiles;
+}
+
+std::span<u32> ChunkTiles::get()
+{
+    std::call_once(mDecoded, [this] { decode(); });
+    return mTiles;
+}
+
+std::optional<std::string> ChunkTiles::error() const
+{
+    std::call_once(mDecoded, [this] { decode(); });
+    return mError;
+}
+
+void ChunkTiles::makeUnique(std::shared_ptr<ChunkTiles>& tiles)
+{
+    if (tiles.use_count() > 1)
+    {
+        tiles = std::make_shared<ChunkTiles>(*tiles);
+        return;
+    }
+
+    // use_count is a relaxed load, this orders the writes after the reads of a thread that just released its copy
+    std::atomic_thread_fence(std::memory_order_acquire);
+}
+
+void ChunkTiles::decode() const
+{
+    LUMIAX_ZONE("ChunkTiles::decode");
+
+    mTiles.resize(mCount);
+    if (auto error = mDecoder(mTiles); error.has_value())
+    {
+        Log::warning("Level", "Could not decode chunk, leaving it empty: {}", *error);
+        std::ranges::fill(mTiles, 0);
+        mError = std::move(error);
+    }
+
+    // Releases the encoded data
+    mDecoder = nullptr;
+}
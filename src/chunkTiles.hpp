@@ -0,0 +1,50 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// Row major tile ids of one chunk. Loaders can hand over the encoded data with a decoder instead of the tiles, which
+// then runs on the first access from whichever thread needs the chunk first. Chunks far away from everything are
+// never decoded, but decoded tiles stay in memory for as long as the chunk exists.
+class ChunkTiles
+{
+public:
+    // Fills tiles, which has the chunk's size, or returns why it could not
+    using Decoder = std::function<std::optional<std::string>(std::span<u32> tiles)>;
+
+    explicit ChunkTiles(std::vector<u32> tiles);
+    ChunkTiles(std::size_t count, Decoder decoder);
+    // Decodes other if it was not decoded yet
+    ChunkTiles(const ChunkTiles& other);
+    ChunkTiles& operator=(const ChunkTiles&) = delete;
+
+    // Thread safe. A chunk that fails to decode logs a warning and reads as empty.
+    std::span<const u32> get() const;
+    // Only for the single owner of this object
+    std::span<u32> get();
+    // Decodes the tiles if needed, returns why decoding failed if it did. For tools that must not write out a
+    // chunk that only reads as empty.
+    std::optional<std::string> error() const;
+
+    std::size_t size() const { return mCount; }
+
+    // Copies tiles unless this is the only reference, so the result can be modified. Other threads may hold copies
+    // of the pointer and read the tiles through them.
+    static void makeUnique(std::shared_ptr<ChunkTiles>& tiles);
+
+private:
+    void decode() const;
+
+    std::size_t mCount{};
+    mutable Decoder mDecoder;
+    mutable std::once_flag mDecoded;
+    mutable std::vector<u32> mTiles;
+    mutable std::optional<std::string> mError;
+};
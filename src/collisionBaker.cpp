@@ -0,0 +1,374 @@
+#include "collisionBaker.hpp"
+
+#include "box2d/b2_body.h"
+#include "box2d/b2_chain_shape.h"
+#include "box2d/b2_fixture.h"
+#include "box2d/b2_world.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace CollisionBaker
+{
+TileGrid::TileGrid(const std::vector<std::vector<Level::Chunk>>& tileLayers)
+{
+    int minX = std::numeric_limits<int>::max();
+    int minY = std::numeric_limits<int>::max();
+    int maxX = std::numeric_limits<int>::min();
+    int maxY = std::numeric_limits<int>::min();
+
+    for (const auto& layer : tileLayers)
+    {
+        for (const auto& chunk : layer)
+        {
+            minX = std::min(minX, chunk.x);
+            minY = std::min(minY, chunk.y);
+            maxX = std::max(maxX, chunk.x + chunk.width);
+            maxY = std::max(maxY, chunk.y + chunk.height);
+        }
+    }
+
+    if (minX > maxX)
+        return;
+
+    mX = minX;
+    mY = minY;
+    mWidth = maxX - minX;
+    mHeight = maxY - minY;
+    mCells.resize(static_cast<std::size_t>(mWidth) * static_cast<std::size_t>(mHeight));
+
+    for (const auto& layer : tileLayers)
+    {
+        for (const auto& chunk : layer)
+            fill(chunk);
+    }
+}
+
+TileGrid::TileGrid(std::span<const Level::Chunk* const> chunks, Region area) :
+    mX{area.x},
+    mY{area.y},
+    mWidth{area.width},
+    mHeight{area.height},
+    mCells(static_cast<std::size_t>(mWidth) * static_cast<std::size_t>(mHeight))
+{
+    for (const auto* chunk : chunks)
+        fill(*chunk);
+}
+
+void TileGrid::fill(const Level::Chunk& chunk)
+{
+    // Clip the chunk to the grid
+    int beginX = std::max(chunk.x, mX);
+    int beginY = std::max(chunk.y, mY);
+    int endX = std::min(chunk.x + chunk.width, mX + mWidth);
+    int endY = std::min(chunk.y + chunk.height, mY + mHeight);
+    if (beginX >= endX || beginY >= endY)
+        return;
+
+    auto tiles = chunk.data();
+
+    for (int y = beginY; y < endY; y++)
+    {
+        for (int x = beginX; x < endX; x++)
+        {
+            if (tiles[(x - chunk.x) + ((y - chunk.y) * chunk.width)] != 0)
+                mCells[(x - mX) + ((y - mY) * mWidth)] = 1;
+        }
+    }
+}
+
+bool TileGrid::solid(int x, int y) const
+{
+    x -= mX;
+    y -= mY;
+
+    if (x < 0 || y < 0 || x >= mWidth || y >= mHeight)
+        return false;
+
+    return mCells[x + (y * mWidth)] != 0;
+}
+
+namespace
+{
+// Edges run along tile borders between tile corners. Corner (x, y) is the top left corner of tile (x, y).
+// Directions are east, south, west, north, clockwise on screen, so (dir + 1) % 4 is a right turn.
+
+constexpr std::array<std::array<int, 2>, 4> directionStep = {{{1, 0}, {0, 1}, {-1, 0}, {0, -1}}};
+// Offset from the start corner to the solid tile an edge belongs to
+constexpr std::array<std::array<int, 2>, 4> ownerOffset = {{{0, 0}, {-1, 0}, {-1, -1}, {0, -1}}};
+// Offset from the owning tile to the empty tile the edge normal points into
+constexpr std::array<std::array<int, 2>, 4> normalOffset = {{{0, -1}, {1, 0}, {0, 1}, {-1, 0}}};
+
+struct Edge
+{
+    int x{};
+    int y{};
+    u8 dir{};
+
+    bool operator==(const Edge&) const = default;
+};
+
+int ownerX(Edge edge)
+{
+    return edge.x + ownerOffset[edge.dir][0];
+}
+
+int ownerY(Edge edge)
+{
+    return edge.y + ownerOffset[edge.dir][1];
+}
+
+int endX(Edge edge)
+{
+    return edge.x + directionStep[edge.dir][0];
+}
+
+int endY(Edge edge)
+{
+    return edge.y + directionStep[edge.dir][1];
+}
+
+// An edge exists where a solid tile borders an empty one. Its normal points into the empty tile, which is what
+// Box2D expects for one-sided chain segments (normal to the right of v1 -> v2 in Box2D's convention).
+bool exists(const TileGrid& grid, Edge edge)
+{
+    int x = ownerX(edge);
+    int y = ownerY(edge);
+    return grid.solid(x, y) && !grid.solid(x + normalOffset[edge.dir][0], y + normalOffset[edge.dir][1]);
+}
+
+// Prefers right turns so that tiles only touching diagonally end up in separate outlines
+Edge next(const TileGrid& grid, Edge edge)
+{
+    for (u8 turn : {1, 0, 3})
+    {
+        Edge candidate{endX(edge), endY(edge), static_cast<u8>((edge.dir + turn) % 4)};
+        if (exists(grid, candidate))
+            return candidate;
+    }
+
+    // Unreachable for a valid edge, every outline is closed
+    return edge;
+}
+
+Edge previous(const TileGrid& grid, Edge edge)
+{
+    for (u8 dir = 0; dir < 4; dir++)
+    {
+        Edge candidate{edge.x - directionStep[dir][0], edge.y - directionStep[dir][1], dir};
+        if (exists(grid, candidate) && next(grid, candidate) == edge)
+            return candidate;
+    }
+
+    return edge;
+}
+
+b2Vec2 cornerToWorld(int x, int y)
+{
+    // Tile bodies are centered on their tile coordinate
+    return {static_cast<float>(x) - 0.5f, static_cast<float>(y) - 0.5f};
+}
+
+bool contains(Region region, int x, int y)
+{
+    return x >= region.x && y >= region.y && x < region.x + region.width && y < region.y + region.height;
+}
+
+bool owned(Region region, Edge edge)
+{
+    return contains(region, ownerX(edge), ownerY(edge));
+}
+} // namespace
+
+RegionCollision bakeRegion(const TileGrid& grid, Region region)
+{
+    RegionCollision result{region, {}};
+
+    // Start corners of edges owned by the region lie within [x, x + width] x [y, y + height]
+    int cornersX = region.width + 1;
+    auto edgeSlot = [&](Edge edge)
+    {
+        return (static_cast<std::size_t>((edge.x - region.x) + ((edge.y - region.y) * cornersX)) * 4) + edge.dir;
+    };
+
+    std::vector<Edge> edges;
+    for (int y = region.y; y < region.y + region.height; y++)
+    {
+        for (int x = region.x; x < region.x + region.width; x++)
+        {
+            if (!grid.solid(x, y))
+                continue;
+
+            for (u8 dir = 0; dir < 4; dir++)
+            {
+                Edge edge{x - ownerOffset[dir][0], y - ownerOffset[dir][1], dir};
+                if (exists(grid, edge))
+                    edges.push_back(edge);
+            }
+        }
+    }
+
+    std::vector<u8> visited(static_cast<std::size_t>(cornersX) * static_cast<std::size_t>(region.height + 1) * 4);
+
+    // Open chains start where the outline enters the region from a neighbouring one
+    for (Edge start : edges)
+    {
+        Edge before = previous(grid, start);
+        if (owned(region, before))
+            continue;
+
+        Chain chain;
+        chain.prevVertex = cornerToWorld(before.x, before.y);
+        chain.vertices.push_back(cornerToWorld(start.x, start.y));
+
+        Edge edge = start;
+        while (true)
+        {
+            visited[edgeSlot(edge)] = 1;
+
+            Edge after = next(grid, edge);
+            if (!owned(region, after))
+            {
+                chain.vertices.push_back(cornerToWorld(endX(edge), endY(edge)));
+                chain.nextVertex = cornerToWorld(endX(after), endY(after));
+                break;
+            }
+
+            if (after.dir != edge.dir)
+                chain.vertices.push_back(cornerToWorld(after.x, after.y));
+
+            edge = after;
+        }
+
+        result.chains.push_back(std::move(chain));
+    }
+
+    // Everything left forms closed outlines, only their corners become loop vertices
+    for (Edge start : edges)
+    {
+        if (visited[edgeSlot(start)] != 0)
+            continue;
+
+        Chain chain;
+        chain.loop = true;
+
+        Edge edge = start;
+        do
+        {
+            visited[edgeSlot(edge)] = 1;
+
+            Edge after = next(grid, edge);
+            if (after.dir != edge.dir)
+                chain.vertices.push_back(cornerToWorld(after.x, after.y));
+
+            edge = after;
+        } while (edge != start);
+
+        result.chains.push_back(std::move(chain));
+    }
+
+    return result;
+}
+
+std::vector<Region> regions(const std::vector<std::vector<Level::Chunk>>& tileLayers)
+{
+    // Tiled writes every layer of an infinite map with the same chunk size, so chunks of different layers either
+    // overlap completely or not at all
+    std::vector<Region> result;
+    for (const auto& layer : tileLayers)
+    {
+        for (const auto& chunk : layer)
+        {
+            result.push_back({chunk.x, chunk.y, chunk.width, chunk.height});
+        }
+    }
+    std::ranges::sort(result);
+    result.erase(std::ranges::unique(result).begin(), result.end());
+
+    return result;
+}
+
+TileGrid regionGrid(const Level& level, Region region)
+{
+    constexpr int margin = regionMargin;
+    Region area{region.x - margin, region.y - margin, region.width + (2 * margin), region.height + (2 * margin)};
+
+    std::vector<const Level::Chunk*> chunks;
+    level.chunksIn({{area.x, area.y}, {area.width, area.height}}, chunks);
+
+    return {chunks, area};
+}
+
+sf::IntRect dirtyReach(const sf::IntRect& dirty)
+{
+    return {dirty.position - sf::Vector2i{regionMargin, regionMargin},
+            dirty.size + sf::Vector2i{2 * regionMargin, 2 * regionMargin}};
+}
+
+bool affects(std::span<const sf::IntRect> dirty, Region region)
+{
+    sf::IntRect bounds{{region.x, region.y}, {region.width, region.height}};
+    return std::ranges::any_of(dirty,
+                               [&](const sf::IntRect& rect)
+                               { return dirtyReach(rect).findIntersection(bounds).has_value(); });
+}
+
+b2Body* rebuildBody(b2World& world, b2Body* body, const Level& level, Region region, u32 id)
+{
+    if (body != nullptr)
+        world.DestroyBody(body);
+
+    auto collision = bakeRegion(regionGrid(level, region), region);
+    return collision.chains.empty() ? nullptr : createBody(world, collision, id);
+}
+
+std::vector<RegionCollision> bake(const std::vector<std::vector<Level::Chunk>>& tileLayers)
+{
+    TileGrid grid(tileLayers);
+
+    auto allRegions = regions(tileLayers);
+
+    std::vector<RegionCollision> result;
+    result.reserve(allRegions.size());
+
+    for (const auto& region : allRegions)
+    {
+        auto collision = bakeRegion(grid, region);
+        if (!collision.chains.empty())
+            result.push_back(std::move(collision));
+    }
+
+    return result;
+}
+
+b2Body* createBody(b2World& world, const RegionCollision& collision, u32 region)
+{
+    b2BodyDef bodyDef;
+    bodyDef.type = b2_staticBody;
+    bodyDef.userData.pointer = region;
+
+    b2Body* body = world.CreateBody(&bodyDef);
+
+    for (const auto& chain : collision.chains)
+    {
+        b2ChainShape shape;
+        if (chain.loop)
+        {
+            shape.CreateLoop(chain.vertices.data(), static_cast<int32>(chain.vertices.size()));
+        }
+        else
+        {
+            shape.CreateChain(
+                chain.vertices.data(), static_cast<int32>(chain.vertices.size()), chain.prevVertex, chain.nextVertex);
+        }
+
+        b2FixtureDef fixtureDef;
+        fixtureDef.shape = &shape;
+
+        body->CreateFixture(&fixtureDef);
+    }
+
+    return body;
+}
+} // namespace CollisionBaker
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "SFML/Graphics/Rect.hpp"
+#include "box2d/b2_math.h"
+#include "level.hpp"
+#include "types.hpp"
+
+#include <span>
+#include <vector>
+
+class b2Body;
+class b2World;
+
+namespace CollisionBaker
+{
+struct Region
+{
+    int x{};
+    int y{};
+    int width{};
+    int height{};
+
+    auto operator<=>(const Region&) const = default;
+};
+
+// Union of the solid cells of all tile layers, addressed in tile coordinates
+class TileGrid
+{
+public:
+    explicit TileGrid(const std::vector<std::vector<Level::Chunk>>& tileLayers);
+    // Only covers area, cells outside of it read as empty. chunks may extend beyond area.
+    TileGrid(std::span<const Level::Chunk* const> chunks, Region area);
+
+    bool solid(int x, int y) const;
+
+private:
+    void fill(const Level::Chunk& chunk);
+
+    int mX{};
+    int mY{};
+    int mWidth{};
+    int mHeight{};
+    std::vector<u8> mCells;
+};
+
+struct Chain
+{
+    std::vector<b2Vec2> vertices;
+    bool loop{};
+    // Ghost vertices of open chains, taken from the outline continuing in the neighbouring region
+    b2Vec2 prevVertex{};
+    b2Vec2 nextVertex{};
+};
+
+struct RegionCollision
+{
+    Region region;
+    std::vector<Chain> chains;
+};
+
+// Traces the outlines of all solid cells inside region. Edges between two solid cells are never emitted, even if
+// the neighbour lies outside of the region, so outlines continue seamlessly across region borders.
+RegionCollision bakeRegion(const TileGrid& grid, Region region);
+
+// Distinct chunk rects of the given layers, sorted
+std::vector<Region> regions(const std::vector<std::vector<Level::Chunk>>& tileLayers);
+
+// Tiles beyond a region that its outlines depend on: the owner of an edge entering the region and the empty tile
+// its normal points into
+constexpr int regionMargin = 2;
+
+// Everything bakeRegion reads for region, copied from the chunks around it. Cost and memory use do not depend on the
+// size of the map, and the grid stays valid when the level changes afterwards.
+TileGrid regionGrid(const Level& level, Region region);
+
+// Tiles whose regions may depend on dirty, in tile coordinates. For finding candidates in a spatial index, affects
+// then tests them exactly.
+sf::IntRect dirtyReach(const sf::IntRect& dirty);
+// Whether the outlines of region depend on any of the dirty tiles
+bool affects(std::span<const sf::IntRect> dirty, Region region);
+// Destroys body unless it is nullptr and bakes region again from the tiles of level. Returns the new body, nullptr
+// if the region has no outlines. id is passed on to createBody.
+b2Body* rebuildBody(b2World& world, b2Body* body, const Level& level, Region region, u32 id);
+
+// Bakes one RegionCollision per distinct chunk rect of the given layers
+std::vector<RegionCollision> bake(const std::vector<std::vector<Level::Chunk>>& tileLayers);
+
+// Static body with one chain fixture per chain of collision, region is stored as its userData
+b2Body* createBody(b2World& world, const RegionCollision& collision, u32 region);
+} // namespace CollisionBaker
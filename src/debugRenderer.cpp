@@ -1,53 +1,189 @@
 #include "debugRenderer.hpp"
-#include "SFML/Graphics/RectangleShape.hpp"
+
+#include "types.hpp"
 
 #include <SFML/Graphics/RenderWindow.hpp>
-#include <SFML/Graphics/VertexArray.hpp>
+#include <algorithm>
+#include <array>
+#include <numbers>
+
+#include <cmath>
+
+namespace
+{
+constexpr int circleSegments = 16;
+constexpr float axisLength = 0.4f;
+
+sf::Color toColor(const b2Color& color, float alphaScale = 1.f)
+{
+    return {static_cast<u8>(color.r * 255.f),
+            static_cast<u8>(color.g * 255.f),
+            static_cast<u8>(color.b * 255.f),
+            static_cast<u8>(color.a * alphaScale * 255.f)};
+}
+
+sf::Vector2f toVector(const b2Vec2& vec)
+{
+    return {vec.x, vec.y};
+}
+
+const std::array<b2Vec2, circleSegments>& unitCircle()
+{
+    static const auto points = []
+    {
+        std::array<b2Vec2, circleSegments> result;
+        for (int i = 0; i < circleSegments; i++)
+        {
+            float angle = 2.f * std::numbers::pi_v<float> * static_cast<float>(i) / circleSegments;
+            result[i] = {std::cos(angle), std::sin(angle)};
+        }
+        return result;
+    }();
+    return points;
+}
+} // namespace
+
+void DebugRenderer::begin()
+{
+    const auto& view = mWindow.getView();
+    mViewBounds = {view.getCenter() - (view.getSize() * 0.5f), view.getSize()};
+    mPixelSize = view.getSize().x / static_cast<float>(std::max(mWindow.getSize().x, 1u));
+}
+
+void DebugRenderer::flush()
+{
+    if (mTriangles.getVertexCount() > 0)
+        mWindow.draw(mTriangles);
+    if (mLines.getVertexCount() > 0)
+        mWindow.draw(mLines);
+
+    mTriangles.clear();
+    mLines.clear();
+}
+
+bool DebugRenderer::visible(const b2Vec2* vertices, int32 vertexCount) const
+{
+    b2Vec2 lower = vertices[0];
+    b2Vec2 upper = vertices[0];
+    for (int32 i = 1; i < vertexCount; i++)
+    {
+        lower = b2Min(lower, vertices[i]);
+        upper = b2Max(upper, vertices[i]);
+    }
+
+    // Degenerate boxes of axis aligned segments still have to intersect, so compare the bounds directly
+    return lower.x <= mViewBounds.position.x + mViewBounds.size.x && upper.x >= mViewBounds.position.x &&
+           lower.y <= mViewBounds.position.y + mViewBounds.size.y && upper.y >= mViewBounds.position.y;
+}
+
+bool DebugRenderer::visible(const b2Vec2& center, float radius) const
+{
+    std::array<b2Vec2, 2> bounds = {{{center.x - radius, center.y - radius}, {center.x + radius, center.y + radius}}};
+    return visible(bounds.data(), 2);
+}
 
-void DebugRenderer::DrawPolygon(const b2Vec2*  /*vertices*/, int32  /*vertexCount*/, const b2Color&  /*color*/)
+void DebugRenderer::appendLine(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color)
 {
-  throw std::runtime_error("Not implemented!");
+    mLines.append({toVector(p1), toColor(color)});
+    mLines.append({toVector(p2), toColor(color)});
+}
+
+void DebugRenderer::DrawPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color)
+{
+    if (!visible(vertices, vertexCount))
+        return;
+
+    for (int32 i = 0; i < vertexCount; i++)
+    {
+        appendLine(vertices[i], vertices[(i + 1) % vertexCount], color);
+    }
 }
 
 void DebugRenderer::DrawSolidPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color)
 {
-    sf::VertexArray vertexArray(sf::PrimitiveType::TriangleFan, vertexCount);
-    sf::Vertex t{{}, sf::Color(color.r * 255.f, color.g * 255.f, color.b * 255.f, color.a * 255.f)};
+    if (!visible(vertices, vertexCount))
+        return;
 
-    for (int i = 0; i < vertexCount; i++)
+    // Translucent fill with a solid outline, like the Box2D testbed
+    sf::Color fillColor = toColor(color, 0.5f);
+    for (int32 i = 1; i + 1 < vertexCount; i++)
     {
-      t.position = sf::Vector2f{vertices[i].x, vertices[i].y};
-      vertexArray[i] = t;
+        mTriangles.append({toVector(vertices[0]), fillColor});
+        mTriangles.append({toVector(vertices[i]), fillColor});
+        mTriangles.append({toVector(vertices[i + 1]), fillColor});
     }
 
-    mWindow.draw(vertexArray);
+    for (int32 i = 0; i < vertexCount; i++)
+    {
+        appendLine(vertices[i], vertices[(i + 1) % vertexCount], color);
+    }
 }
 
-void DebugRenderer::DrawCircle(const b2Vec2&  /*center*/, float  /*radius*/, const b2Color&  /*color*/)
+void DebugRenderer::DrawCircle(const b2Vec2& center, float radius, const b2Color& color)
 {
-  throw std::runtime_error("Not implemented!");
+    if (!visible(center, radius))
+        return;
+
+    const auto& circle = unitCircle();
+    for (int i = 0; i < circleSegments; i++)
+    {
+        appendLine(center + (radius * circle[i]), center + (radius * circle[(i + 1) % circleSegments]), color);
+    }
 }
 
-void DebugRenderer::DrawSolidCircle(const b2Vec2&  /*center*/, float  /*radius*/, const b2Vec2&  /*axis*/, const b2Color&  /*color*/)
+void DebugRenderer::DrawSolidCircle(const b2Vec2& center, float radius, const b2Vec2& axis, const b2Color& color)
 {
-  throw std::runtime_error("Not implemented!");
+    if (!visible(center, radius))
+        return;
+
+    sf::Color fillColor = toColor(color, 0.5f);
+    const auto& circle = unitCircle();
+    for (int i = 0; i < circleSegments; i++)
+    {
+        b2Vec2 p1 = center + (radius * circle[i]);
+        b2Vec2 p2 = center + (radius * circle[(i + 1) % circleSegments]);
+
+        mTriangles.append({toVector(center), fillColor});
+        mTriangles.append({toVector(p1), fillColor});
+        mTriangles.append({toVector(p2), fillColor});
+
+        appendLine(p1, p2, color);
+    }
+
+    appendLine(center, center + (radius * axis), color);
 }
 
-void DebugRenderer::DrawSegment(const b2Vec2&  /*p1*/, const b2Vec2&  /*p2*/, const b2Color&  /*color*/)
+void DebugRenderer::DrawSegment(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color)
 {
-  throw std::runtime_error("Not implemented!");
+    std::array<b2Vec2, 2> points = {p1, p2};
+    if (!visible(points.data(), 2))
+        return;
+
+    appendLine(p1, p2, color);
 }
 
 void DebugRenderer::DrawTransform(const b2Transform& xf)
 {
-  float size = 0.1f;
-  sf::RectangleShape point({size, size});
-  point.setPosition({xf.p.x - (size * 0.5f), xf.p.y - (size * 0.5f)});
-  point.setFillColor(sf::Color::Red);
-  mWindow.draw(point);
+    if (!visible(xf.p, axisLength))
+        return;
+
+    appendLine(xf.p, xf.p + (axisLength * xf.q.GetXAxis()), b2Color(1.f, 0.f, 0.f));
+    appendLine(xf.p, xf.p + (axisLength * xf.q.GetYAxis()), b2Color(0.f, 1.f, 0.f));
 }
 
-void DebugRenderer::DrawPoint(const b2Vec2&  /*p*/, float  /*size*/, const b2Color&  /*color*/)
+void DebugRenderer::DrawPoint(const b2Vec2& p, float size, const b2Color& color)
 {
-  throw std::runtime_error("Not implemented!");
+    float halfSize = 0.5f * size * mPixelSize;
+    if (!visible(p, halfSize))
+        return;
+
+    sf::Color pointColor = toColor(color);
+    std::array<sf::Vector2f, 4> corners = {{{p.x - halfSize, p.y - halfSize},
+                                            {p.x + halfSize, p.y - halfSize},
+                                            {p.x - halfSize, p.y + halfSize},
+                                            {p.x + halfSize, p.y + halfSize}}};
+    for (std::size_t corner : {0, 1, 2, 2, 1, 3})
+    {
+        mTriangles.append({corners[corner], pointColor});
+    }
 }
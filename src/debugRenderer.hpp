@@ -2,16 +2,26 @@
 
 #include "box2d/b2_draw.h"
 
+#include <SFML/Graphics/Rect.hpp>
+#include <SFML/Graphics/VertexArray.hpp>
+
 namespace sf
 {
 class RenderWindow;
 }
 
+// Collects everything b2World::DebugDraw emits into one triangle and one line batch, primitives outside of the view
+// are dropped. Call begin before and flush after b2World::DebugDraw.
 class DebugRenderer : public b2Draw
 {
 public:
     DebugRenderer(sf::RenderWindow& window) : mWindow{window} {}
 
+    // Picks up the current view of the window for culling
+    void begin();
+    // Draws and clears the batches
+    void flush();
+
     void DrawPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color) override;
     void DrawSolidPolygon(const b2Vec2* vertices, int32 vertexCount, const b2Color& color) override;
     void DrawCircle(const b2Vec2& center, float radius, const b2Color& color) override;
@@ -21,5 +31,17 @@ public:
     void DrawPoint(const b2Vec2& p, float size, const b2Color& color) override;
 
 private:
+    bool visible(const b2Vec2* vertices, int32 vertexCount) const;
+    bool visible(const b2Vec2& center, float radius) const;
+
+    void appendLine(const b2Vec2& p1, const b2Vec2& p2, const b2Color& color);
+
     sf::RenderWindow& mWindow;
+
+    sf::FloatRect mViewBounds;
+    // World units per screen pixel, DrawPoint sizes are given in pixels
+    float mPixelSize{1.f};
+
+    sf::VertexArray mTriangles{sf::PrimitiveType::Triangles};
+    sf::VertexArray mLines{sf::PrimitiveType::Lines};
 };
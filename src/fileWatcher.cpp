@@ -0,0 +1,104 @@
+#include "fileWatcher.hpp"
+
+#include <algorithm>
+#include <array>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+
+namespace
+{
+std::filesystem::file_time_type writeTime(const std::filesystem::path& path)
+{
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(path, error);
+    return error ? std::filesystem::file_time_type{} : time;
+}
+} // namespace
+
+FileWatcher::FileWatcher()
+{
+#ifdef __linux__
+    // Falls back to polling modification times if inotify is unavailable
+    mFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+    if (mFd >= 0)
+        close(mFd);
+#endif
+}
+
+void FileWatcher::watch(const std::filesystem::path& file)
+{
+    auto path = std::filesystem::absolute(file).lexically_normal();
+    if (std::ranges::any_of(mFiles, [&](const File& watched) { return watched.path == path; }))
+        return;
+
+    mFiles.push_back({path, writeTime(path)});
+
+#ifdef __linux__
+    auto directory = path.parent_path();
+    if (mFd < 0 || std::ranges::any_of(mDirectories, [&](const Directory& dir) { return dir.path == directory; }))
+        return;
+
+    // Close after write covers saving in place, moved to and create cover saving through a temporary file
+    int watch = inotify_add_watch(mFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (watch >= 0)
+        mDirectories.push_back({watch, directory});
+#endif
+}
+
+bool FileWatcher::poll()
+{
+    bool changed = false;
+
+#ifdef __linux__
+    if (mFd >= 0)
+    {
+        alignas(inotify_event) std::array<char, 4096> buffer;
+        while (true)
+        {
+            auto length = read(mFd, buffer.data(), buffer.size());
+            if (length <= 0)
+                break;
+
+            for (std::size_t offset = 0; offset < static_cast<std::size_t>(length);)
+            {
+                inotify_event event;
+                std::memcpy(&event, buffer.data() + offset, sizeof(event));
+                const char* name = buffer.data() + offset + sizeof(event);
+                offset += sizeof(event) + event.len;
+
+                auto directory = std::ranges::find(mDirectories, event.wd, &Directory::watch);
+                if (event.len == 0 || directory == mDirectories.end())
+                    continue;
+
+                auto path = directory->path / name;
+                changed = changed || std::ranges::any_of(mFiles, [&](const File& file) { return file.path == path; });
+            }
+        }
+
+        return changed;
+    }
+#endif
+
+    for (auto& file : mFiles)
+    {
+        auto time = writeTime(file.path);
+        if (time != file.writeTime)
+        {
+            file.writeTime = time;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
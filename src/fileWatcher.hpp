@@ -0,0 +1,41 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+// Reports writes to a set of files. Uses inotify on Linux, elsewhere compares modification times on every poll.
+// Directories are watched instead of the files themselves, so editors that save by replacing the file are seen too.
+class FileWatcher
+{
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Adding a file that is already watched does nothing
+    void watch(const std::filesystem::path& file);
+
+    // True if a watched file was written or replaced since the last call, never blocks
+    bool poll();
+
+private:
+    struct File
+    {
+        std::filesystem::path path;
+        std::filesystem::file_time_type writeTime;
+    };
+
+    std::vector<File> mFiles;
+#ifdef __linux__
+    struct Directory
+    {
+        int watch{};
+        std::filesystem::path path;
+    };
+
+    int mFd{-1};
+    std::vector<Directory> mDirectories;
+#endif
+};
@@ -0,0 +1,144 @@
+#include "gameClient.hpp"
+
+#include <algorithm>
+#include <format>
+
+std::expected<GameClient, std::string> GameClient::connect(sf::IpAddress server, u16 port)
+{
+    GameClient client(server, port);
+
+    if (client.mSocket.bind(sf::Socket::AnyPort) != sf::Socket::Status::Done)
+        return std::unexpected(std::format("Could not bind a UDP port to connect to port {}", port));
+    client.mSocket.setBlocking(false);
+
+    client.input(0);
+
+    return client;
+}
+
+GameClient::GameClient(sf::IpAddress server, u16 port) :
+    mServer{server},
+    mPort{port},
+    mReceiveBuffer(sf::UdpSocket::MaxDatagramSize)
+{
+}
+
+void GameClient::input(u8 thrusters)
+{
+    mPacket.clear();
+    NetProtocol::PacketWriter writer(mPacket);
+
+    if (!mShip.has_value())
+    {
+        writer.writeHeader(NetProtocol::MessageType::Hello);
+    }
+    else
+    {
+        writer.writeHeader(NetProtocol::MessageType::Input);
+        writer.writeVarint(mLatestTick);
+        writer.write(thrusters);
+    }
+
+    send();
+}
+
+bool GameClient::receive()
+{
+    u32 latestTick = mLatestTick;
+
+    while (true)
+    {
+        std::size_t received = 0;
+        std::optional<sf::IpAddress> address;
+        unsigned short port = 0;
+
+        auto status = mSocket.receive(mReceiveBuffer.data(), mReceiveBuffer.size(), received, address, port);
+        if (status != sf::Socket::Status::Done)
+            break;
+
+        if (address == mServer && port == mPort)
+        {
+            mBytesReceived += received;
+            handle(std::span(mReceiveBuffer.data(), received));
+        }
+    }
+
+    if (mLatestTick == latestTick)
+        return false;
+
+    // A later state that failed to decode may have reset the slot of a received tick, like handle checks for bases
+    auto stored = [&](u32 tick)
+    {
+        return tick != 0 && mLatestTick - tick < NetProtocol::historySize &&
+               mHistory[tick % NetProtocol::historySize].tick == tick;
+    };
+    if (!stored(mLatestTick))
+        return false;
+
+    const auto& current = mHistory[mLatestTick % NetProtocol::historySize];
+    bool hasPrevious = stored(mPreviousTick);
+    NetProtocol::dequantize(hasPrevious ? mHistory[mPreviousTick % NetProtocol::historySize] : current,
+                            current,
+                            mSnapshot);
+    mSnapshot.time = std::chrono::steady_clock::now();
+    mSnapshot.followedShip = mShip.value_or(0);
+
+    return true;
+}
+
+float GameClient::interpolationAlpha() const
+{
+    auto sinceTick = std::chrono::steady_clock::now() - mSnapshot.time;
+    return std::clamp(std::chrono::duration<float>(sinceTick) / std::chrono::duration<float>(mTickDuration), 0.f, 1.f);
+}
+
+void GameClient::handle(std::span<const u8> packet)
+{
+    NetProtocol::PacketReader reader(packet);
+    auto type = reader.readHeader();
+
+    if (type == NetProtocol::MessageType::Welcome)
+    {
+        u64 ship{};
+        u64 tickMicroseconds{};
+        if (reader.readVarint(ship) && reader.readVarint(tickMicroseconds) && tickMicroseconds > 0)
+        {
+            mShip = static_cast<u32>(ship);
+            mTickDuration = std::chrono::microseconds(tickMicroseconds);
+        }
+        return;
+    }
+
+    if (type != NetProtocol::MessageType::Snapshot)
+        return;
+
+    u64 tick{};
+    u64 baseTick{};
+    if (!reader.readVarint(tick) || !reader.readVarint(baseTick) || tick <= mLatestTick || tick <= baseTick)
+        return;
+
+    // Deltas against states that are no longer in the history can not be decoded, the next ack fixes that
+    static const NetProtocol::State fullBase{};
+    if (baseTick != 0 && (baseTick > mLatestTick || tick - baseTick >= NetProtocol::historySize ||
+                          mHistory[baseTick % NetProtocol::historySize].tick != baseTick))
+        return;
+
+    const auto& base = baseTick != 0 ? mHistory[baseTick % NetProtocol::historySize] : fullBase;
+    auto& state = mHistory[tick % NetProtocol::historySize];
+    if (!NetProtocol::readState(reader, base, state))
+    {
+        // A half decoded state must never serve as base
+        state.tick = 0;
+        return;
+    }
+    state.tick = static_cast<u32>(tick);
+
+    mPreviousTick = mLatestTick;
+    mLatestTick = static_cast<u32>(tick);
+}
+
+void GameClient::send()
+{
+    // Lost input is replaced by the next one
+    (void)mSocket.send(mPacket.data(), mPacket.size(), mServer, mPort);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "netProtocol.hpp"
+#include "renderSnapshot.hpp"
+#include "types.hpp"
+
+#include <SFML/Network/IpAddress.hpp>
+#include <SFML/Network/UdpSocket.hpp>
+#include <chrono>
+#include <expected>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Connection to a GameServer. Sends thruster input, acknowledges received snapshots and turns the two newest states
+// into a RenderSnapshot, so rendering works the same as with a local SimulationThread.
+class GameClient
+{
+public:
+    // Binds a local port and starts joining, nothing blocks
+    static std::expected<GameClient, std::string> connect(sf::IpAddress server, u16 port);
+
+    // Sends the thruster state of the own ship together with the newest acknowledged tick. Until the server
+    // answered, a join request is sent instead.
+    void input(u8 thrusters);
+
+    // Handles pending packets, returns true if a newer state arrived
+    bool receive();
+
+    std::optional<u32> ship() const { return mShip; }
+    u64 bytesReceived() const { return mBytesReceived; }
+    u32 latestTick() const { return mLatestTick; }
+
+    const RenderSnapshot& snapshot() const { return mSnapshot; }
+    // Blend factor for the snapshot at the current time, see SimulationThread::interpolationAlpha
+    float interpolationAlpha() const;
+
+private:
+    GameClient(sf::IpAddress server, u16 port);
+
+    void handle(std::span<const u8> packet);
+    void send();
+
+    sf::UdpSocket mSocket;
+    sf::IpAddress mServer;
+    u16 mPort{};
+
+    std::optional<u32> mShip;
+    std::chrono::steady_clock::duration mTickDuration{std::chrono::milliseconds(16)};
+
+    // Received state of tick t is stored at t % historySize
+    std::vector<NetProtocol::State> mHistory{NetProtocol::historySize};
+    u32 mLatestTick{};
+    u32 mPreviousTick{};
+    RenderSnapshot mSnapshot;
+
+    u64 mBytesReceived{};
+    std::vector<u8> mPacket;
+    std::vector<u8> mReceiveBuffer;
+};
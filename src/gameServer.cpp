@@ -0,0 +1,177 @@
+#include "gameServer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <format>
+
+namespace
+{
+// Clients that stopped sending input are dropped after this, their ship drifts on without thrust
+constexpr std::chrono::seconds clientTimeout{5};
+
+const std::array<sf::Color, 6> shipColors = {
+    sf::Color::Green, sf::Color::Red, sf::Color::Blue, sf::Color::Yellow, sf::Color::Magenta, sf::Color::Cyan};
+} // namespace
+
+std::expected<GameServer, std::string> GameServer::bind(Simulation& simulation, u16 port)
+{
+    GameServer server(simulation);
+
+    if (server.mSocket.bind(port) != sf::Socket::Status::Done)
+        return std::unexpected(std::format("Could not bind UDP port {}", port));
+    server.mSocket.setBlocking(false);
+
+    return server;
+}
+
+GameServer::GameServer(Simulation& simulation) :
+    mSimulation{simulation},
+    mReceiveBuffer(sf::UdpSocket::MaxDatagramSize)
+{
+}
+
+GameServer::ClientStats GameServer::clientStats(std::size_t client) const
+{
+    return mClients[client].stats;
+}
+
+std::chrono::nanoseconds GameServer::tick()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    receive();
+
+    std::erase_if(mClients, [&](const Client& client) { return start - client.lastHeard > clientTimeout; });
+
+    mInput.ships.assign(mSimulation.ships().size(), ShipInput{});
+    for (const auto& client : mClients)
+        mInput.ships[client.ship].thrusters = client.thrusters;
+
+    mSimulation.step(mInput);
+
+    auto& state = mHistory[mSimulation.tick() % NetProtocol::historySize];
+    NetProtocol::quantize(mSimulation, state);
+
+    for (auto& client : mClients)
+        sendSnapshot(client);
+
+    return std::chrono::steady_clock::now() - start;
+}
+
+void GameServer::receive()
+{
+    while (true)
+    {
+        std::size_t received = 0;
+        std::optional<sf::IpAddress> address;
+        unsigned short port = 0;
+
+        auto status = mSocket.receive(mReceiveBuffer.data(), mReceiveBuffer.size(), received, address, port);
+        if (status != sf::Socket::Status::Done)
+            break;
+
+        if (address.has_value())
+            handle(*address, port, std::span(mReceiveBuffer.data(), received));
+    }
+}
+
+void GameServer::handle(const sf::IpAddress& address, u16 port, std::span<const u8> packet)
+{
+    NetProtocol::PacketReader reader(packet);
+    auto type = reader.readHeader();
+    if (!type.has_value())
+        return;
+
+    if (*type == NetProtocol::MessageType::Hello)
+    {
+        // Repeated hellos are answered again in case the welcome got lost
+        sendWelcome(join(address, port));
+        return;
+    }
+
+    auto client = std::ranges::find_if(mClients,
+                                       [&](const Client& candidate)
+                                       { return candidate.address == address && candidate.port == port; });
+    if (*type != NetProtocol::MessageType::Input || client == mClients.end())
+        return;
+
+    u64 ackTick{};
+    u8 thrusters{};
+    if (!reader.readVarint(ackTick) || !reader.read(thrusters))
+        return;
+
+    client->thrusters = thrusters;
+    // Datagrams arrive out of order, acknowledgements only move forward
+    client->ackTick = std::max(client->ackTick, static_cast<u32>(ackTick));
+    client->lastHeard = std::chrono::steady_clock::now();
+    client->stats.bytesReceived += packet.size();
+}
+
+GameServer::Client& GameServer::join(const sf::IpAddress& address, u16 port)
+{
+    for (auto& client : mClients)
+    {
+        if (client.address == address && client.port == port)
+            return client;
+    }
+
+    // Ships of dropped clients are reused before spawning new ones
+    u32 ship = 0;
+    while (ship < mSimulation.ships().size() &&
+           std::ranges::any_of(mClients, [&](const Client& client) { return client.ship == ship; }))
+        ship++;
+
+    if (ship == mSimulation.ships().size())
+    {
+        sf::Vector2f position{5.f + (static_cast<float>(ship % 16) * 1.5f),
+                              10.f + (static_cast<float>(ship / 16) * 2.f)};
+        mSimulation.addShip(shipColors[ship % shipColors.size()], {1.f, 1.4f}, position);
+    }
+
+    return mClients.emplace_back(Client{.address = address,
+                                        .port = port,
+                                        .ship = ship,
+                                        .lastHeard = std::chrono::steady_clock::now(),
+                                        .stats = {.ship = ship}});
+}
+
+void GameServer::sendWelcome(Client& client)
+{
+    mPacket.clear();
+    NetProtocol::PacketWriter writer(mPacket);
+    writer.writeHeader(NetProtocol::MessageType::Welcome);
+    writer.writeVarint(client.ship);
+    writer.writeVarint(static_cast<u64>(mSimulation.fixedStep().asMicroseconds()));
+    send(client);
+}
+
+void GameServer::sendSnapshot(Client& client)
+{
+    static const NetProtocol::State fullBase{};
+
+    u32 tick = static_cast<u32>(mSimulation.tick());
+    const auto& current = mHistory[tick % NetProtocol::historySize];
+
+    // Only acknowledged states still in the history can serve as base
+    bool hasBase = client.ackTick != 0 && client.ackTick < tick && tick - client.ackTick < NetProtocol::historySize;
+    const auto& base = hasBase ? mHistory[client.ackTick % NetProtocol::historySize] : fullBase;
+
+    mPacket.clear();
+    NetProtocol::PacketWriter writer(mPacket);
+    writer.writeHeader(NetProtocol::MessageType::Snapshot);
+    writer.writeVarint(tick);
+    writer.writeVarint(hasBase ? client.ackTick : 0);
+    NetProtocol::writeState(writer, base, current);
+
+    if (!hasBase)
+        client.stats.fullSnapshots++;
+
+    send(client);
+}
+
+void GameServer::send(Client& client)
+{
+    // Losing a datagram is fine, the next snapshot or welcome replaces it
+    if (mSocket.send(mPacket.data(), mPacket.size(), client.address, client.port) == sf::Socket::Status::Done)
+        client.stats.bytesSent += mPacket.size();
+}
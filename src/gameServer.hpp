@@ -0,0 +1,69 @@
+#pragma once
+
+#include "netProtocol.hpp"
+#include "simulation.hpp"
+#include "types.hpp"
+
+#include <SFML/Network/IpAddress.hpp>
+#include <SFML/Network/UdpSocket.hpp>
+#include <chrono>
+#include <expected>
+#include <string>
+#include <vector>
+
+// Authoritative simulation for networked clients. Every tick applies the latest input of each client to its ship,
+// steps the simulation and sends each client a snapshot delta compressed against the newest state it acknowledged.
+class GameServer
+{
+public:
+    struct ClientStats
+    {
+        u32 ship{};
+        u64 bytesSent{};
+        u64 bytesReceived{};
+        u64 fullSnapshots{};
+    };
+
+    // Binds to port on all interfaces, use sf::Socket::AnyPort to let the system pick one
+    static std::expected<GameServer, std::string> bind(Simulation& simulation, u16 port);
+
+    // Handles pending packets, spawns ships for new clients, steps the simulation and sends snapshots. Returns the
+    // duration of the whole tick.
+    std::chrono::nanoseconds tick();
+
+    u16 port() const { return mSocket.getLocalPort(); }
+    std::size_t clientCount() const { return mClients.size(); }
+    ClientStats clientStats(std::size_t client) const;
+
+private:
+    struct Client
+    {
+        sf::IpAddress address;
+        u16 port{};
+        u32 ship{};
+        u8 thrusters{};
+        // Newest tick the client received a snapshot of, 0 for none
+        u32 ackTick{};
+        std::chrono::steady_clock::time_point lastHeard;
+        ClientStats stats;
+    };
+
+    explicit GameServer(Simulation& simulation);
+
+    void receive();
+    void handle(const sf::IpAddress& address, u16 port, std::span<const u8> packet);
+    Client& join(const sf::IpAddress& address, u16 port);
+    void sendWelcome(Client& client);
+    void sendSnapshot(Client& client);
+    void send(Client& client);
+
+    Simulation& mSimulation;
+    sf::UdpSocket mSocket;
+    std::vector<Client> mClients;
+
+    TickInput mInput;
+    // Quantized state of tick t is stored at t % historySize
+    std::vector<NetProtocol::State> mHistory{NetProtocol::historySize};
+    std::vector<u8> mPacket;
+    std::vector<u8> mReceiveBuffer;
+};
@@ -5,17 +5,112 @@
 #include "box2d/b2_fixture.h"
 #include "box2d/b2_polygon_shape.h"
 #include "box2d/b2_world.h"
+#include "collisionBaker.hpp"
 
+#include <algorithm>
+#include <format>
 #include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include <cstring>
+
+namespace
+{
+b2Body* createRectBody(b2World& world, const Level::Rect& rect, u32 id)
+{
+    b2BodyDef bodyDef;
+    bodyDef.userData.pointer = Level::rectBodyFlag | id;
+    bodyDef.type = rect.animationIndex.has_value() ? b2_kinematicBody : b2_staticBody;
+    bodyDef.position.Set(rect.position.x / 32.f, ((rect.position.y + (0.5f * rect.size.y)) / 32.f) - 0.5f);
+
+    b2Body* body = world.CreateBody(&bodyDef);
+
+    b2PolygonShape box;
+    box.SetAsBox(0.5f * rect.size.x / 32.f, 0.5f * rect.size.y / 32.f);
+
+    b2FixtureDef fixtureDef;
+    fixtureDef.shape = &box;
+    fixtureDef.density = 0.f;
+
+    body->CreateFixture(&fixtureDef);
+
+    return body;
+}
+} // namespace
 
 void Level::addChunk(unsigned layer, Chunk chunk)
 {
+    mTileCollision.reset();
+
     if (layer >= static_cast<unsigned>(mTiles.size()))
         mTiles.resize(layer + 1);
 
+    mChunkGrid.insert(static_cast<u32>(mChunkRefs.size()),
+                      {{static_cast<float>(chunk.x), static_cast<float>(chunk.y)},
+                       {static_cast<float>(chunk.width), static_cast<float>(chunk.height)}});
+    mChunkRefs.push_back({layer, static_cast<u32>(mTiles[layer].size())});
+
     mTiles[layer].emplace_back(std::move(chunk));
 }
 
+void Level::chunksIn(sf::IntRect area, std::vector<const Chunk*>& result) const
+{
+    std::vector<u32> candidates;
+    mChunkGrid.query({sf::Vector2f(area.position), sf::Vector2f(area.size)}, candidates);
+
+    for (u32 candidate : candidates)
+    {
+        const auto& [layer, index] = mChunkRefs[candidate];
+        const auto& chunk = mTiles[layer][index];
+        if (area.findIntersection({{chunk.x, chunk.y}, {chunk.width, chunk.height}}).has_value())
+            result.push_back(&chunk);
+    }
+}
+
+bool Level::setTile(unsigned layer, int x, int y, u32 gid)
+{
+    std::vector<u32> candidates;
+    mChunkGrid.query({{static_cast<float>(x), static_cast<float>(y)}, {1.f, 1.f}}, candidates);
+
+    auto contains = [&](u32 candidate)
+    {
+        const auto& ref = mChunkRefs[candidate];
+        const auto& chunk = mTiles[ref.layer][ref.chunk];
+        return ref.layer == layer && x >= chunk.x && y >= chunk.y && x < chunk.x + chunk.width &&
+               y < chunk.y + chunk.height;
+    };
+    auto found = std::ranges::find_if(candidates, contains);
+    if (found == candidates.end())
+        return false;
+
+    const auto& ref = mChunkRefs[*found];
+    auto& current = mTiles[ref.layer][ref.chunk];
+    auto offset = static_cast<std::size_t>((x - current.x) + ((y - current.y) * current.width));
+    u32 previous = current.data()[offset];
+    if (previous == gid)
+        return true;
+
+    // Only this chunk is copied, other instances and readers keep the tiles they hold
+    ChunkTiles::makeUnique(current.tiles);
+    current.tiles->get()[offset] = gid;
+    mTileCollision.reset();
+
+    if ((previous != 0) != (gid != 0))
+        mDirtyTiles.push_back({{x, y}, {1, 1}});
+    if (mRecordTileEdits)
+        mTileEdits.push_back({layer, x, y, gid});
+
+    return true;
+}
+
+std::size_t Level::repairTileCollision()
+{
+    auto rebuilt = rebuildTileCollision(mDirtyTiles);
+    mDirtyTiles.clear();
+    return rebuilt;
+}
+
 void Level::addRect(unsigned layer, unsigned id, Rect rect)
 {
     if (layer >= static_cast<unsigned>(mRectLayers.size()))
@@ -34,7 +129,68 @@ void Level::addAnimation(unsigned layer, unsigned id, Animation animation)
 
 void Level::addTileset(Tileset tileset)
 {
-    mTilesets.push_back(std::move(tileset));
+    if (mTilesets.use_count() > 1)
+        mTilesets = std::make_shared<std::vector<Tileset>>(*mTilesets);
+
+    mTilesets->push_back(std::move(tileset));
+}
+
+Level Level::instance() const
+{
+    Level level;
+    level.mTiles = mTiles;
+    level.mTilesets = mTilesets;
+    level.mTileCollision = mTileCollision;
+    level.mChunkGrid = mChunkGrid;
+    level.mChunkRefs = mChunkRefs;
+    level.mRectLayers = mRectLayers;
+    level.mAnimationLayers = mAnimationLayers;
+    level.mTilesetPath = mTilesetPath;
+    level.mSourceFiles = mSourceFiles;
+    return level;
+}
+
+void Level::addSourceFile(std::filesystem::path path)
+{
+    mSourceFiles.push_back(std::move(path));
+}
+
+void Level::bakeCollision()
+{
+    if (mTileCollision != nullptr)
+        return;
+
+    using Collision = std::vector<CollisionBaker::RegionCollision>;
+    mTileCollision = std::make_shared<const Collision>(CollisionBaker::bake(mTiles));
+}
+
+std::optional<std::string> Level::checkAnimations() const
+{
+    std::unordered_map<unsigned, std::size_t> pointCounts;
+    for (std::size_t layerIndex = 0; layerIndex < mRectLayers.size(); layerIndex++)
+    {
+        pointCounts.clear();
+        if (layerIndex < mAnimationLayers.size())
+        {
+            for (const auto& [id, animation] : mAnimationLayers[layerIndex])
+                pointCounts.emplace(id, animation.points.size());
+        }
+
+        for (const auto& [id, rect] : mRectLayers[layerIndex])
+        {
+            if (!rect.animationIndex.has_value())
+                continue;
+
+            unsigned animationId = *rect.animationIndex;
+            auto found = pointCounts.find(animationId);
+            if (found == pointCounts.end())
+                return std::format("Animation in layer {} with id {} could not be found", layerIndex, animationId);
+            if (found->second < 2)
+                return std::format("Animation in layer {} with id {} needs at least 2 points", layerIndex, animationId);
+        }
+    }
+
+    return std::nullopt;
 }
 
 void Level::registerCollision(b2World& world)
@@ -45,143 +201,333 @@ void Level::registerCollision(b2World& world)
 
 void Level::registerTileCollision(b2World& world)
 {
-    if (!mTileBodies.empty())
+    if (mTilesRegistered)
         throw std::runtime_error("register should only be called once");
 
-    for (const auto& layer : mTiles)
-    {
-        for (const auto& chunk : layer)
-        {
-            for (int x = 0; x < chunk.width; x++)
-            {
-                for (int y = 0; y < chunk.height; y++)
-                {
-                    int linearIndex = x + (y * chunk.width);
-
-                    if (chunk.data[linearIndex] != 0)
-                    {
-                        b2Vec2 pos{static_cast<float>(chunk.x + x), static_cast<float>(chunk.y + y)};
-                        b2Vec2 size{1.f, 1.f};
+    bakeCollision();
+    mWorld = &world;
+    mTilesRegistered = true;
 
-                        b2BodyDef bodyDef;
-                        bodyDef.type = b2_staticBody;
-                        bodyDef.position.Set(pos.x, pos.y);
+    // Baked collision skips empty regions, both lists are sorted
+    auto regions = CollisionBaker::regions(mTiles);
+    auto baked = mTileCollision->begin();
+    for (const auto& region : regions)
+    {
+        mTileRegionGrid.insert(static_cast<u32>(mTileRegions.size()),
+                               {{static_cast<float>(region.x), static_cast<float>(region.y)},
+                                {static_cast<float>(region.width), static_cast<float>(region.height)}});
+        mTileRegions.push_back({{region.x, region.y}, {region.width, region.height}});
+        auto& body = mTileBodies.emplace_back();
 
-                        b2Body* body = world.CreateBody(&bodyDef);
+        if (baked != mTileCollision->end() && baked->region == region)
+        {
+            body = CollisionBaker::createBody(world, *baked, static_cast<u32>(mTileRegions.size() - 1));
+            ++baked;
+        }
+    }
+}
 
-                        b2PolygonShape box;
-                        box.SetAsBox(0.5f, 0.5f);
+std::size_t Level::rebuildTileCollision(std::span<const sf::IntRect> dirty)
+{
+    if (!mTilesRegistered || dirty.empty())
+        return 0;
 
-                        b2FixtureDef fixtureDef;
-                        fixtureDef.shape = &box;
+    // Regions are found through the grid, so the cost depends on the dirty area and not on the map
+    std::vector<u32> affected;
+    for (const auto& rect : dirty)
+    {
+        auto reach = CollisionBaker::dirtyReach(rect);
+        mTileRegionGrid.query({sf::Vector2f(reach.position), sf::Vector2f(reach.size)}, affected);
+    }
+    std::ranges::sort(affected);
+    affected.erase(std::ranges::unique(affected).begin(), affected.end());
 
-                        body->CreateFixture(&fixtureDef);
+    std::size_t rebuilt = 0;
+    for (u32 index : affected)
+    {
+        const auto& region = mTileRegions[index];
+        CollisionBaker::Region bounds{region.position.x, region.position.y, region.size.x, region.size.y};
+        if (!CollisionBaker::affects(dirty, bounds))
+            continue;
 
-                        mTileBodies.push_back(body);
-                    }
-                }
-            }
-        }
+        mTileBodies[index] = CollisionBaker::rebuildBody(*mWorld, mTileBodies[index], *this, bounds, index);
+        rebuilt++;
     }
+
+    return rebuilt;
 }
+
 void Level::registerRectCollisions(b2World& world)
 {
-    if (!mRectBodyLayers.empty())
+    if (mRectsRegistered)
         throw std::runtime_error("register should only be called once");
 
+    mWorld = &world;
+    mRectsRegistered = true;
+
+    // Animations are referenced by object id, resolve them to slots once instead of searching every tick
+    std::vector<std::unordered_map<unsigned, u32>> animationSlots(mAnimationLayers.size());
+    for (std::size_t layerIndex = 0; layerIndex < mAnimationLayers.size(); layerIndex++)
+    {
+        for (std::size_t slot = 0; slot < mAnimationLayers[layerIndex].size(); slot++)
+            animationSlots[layerIndex].emplace(mAnimationLayers[layerIndex][slot].id, static_cast<u32>(slot));
+    }
+
+    u32 bodyId = 0;
     for (std::size_t layerIndex = 0; layerIndex < mRectLayers.size(); layerIndex++)
     {
-        for (const auto& [id, rect] : mRectLayers[layerIndex])
+        for (std::size_t rectIndex = 0; rectIndex < mRectLayers[layerIndex].size(); rectIndex++)
         {
-            b2BodyDef bodyDef;
-            bodyDef.type = rect.animationIndex.has_value() ? b2_dynamicBody : b2_staticBody;
-            bodyDef.position.Set(rect.position.x / 32.f, ((rect.position.y + (0.5f * rect.size.y)) / 32.f) - 0.5f);
-
-            b2Body* boxBody = world.CreateBody(&bodyDef);
+            const auto& [id, rect] = mRectLayers[layerIndex][rectIndex];
 
-            b2PolygonShape box;
-            box.SetAsBox(0.5f * rect.size.x / 32.f, 0.5f * rect.size.y / 32.f);
-
-            b2FixtureDef fixtureDef;
-            fixtureDef.shape = &box;
-            fixtureDef.density = 0.f;
-
-            boxBody->CreateFixture(&fixtureDef);
+            b2Body* boxBody = createRectBody(world, rect, bodyId++);
 
             if (mRectBodyLayers.size() <= layerIndex)
                 mRectBodyLayers.resize(layerIndex + 1);
 
             mRectBodyLayers[layerIndex].emplace_back(id, boxBody);
+
+            if (!rect.animationIndex.has_value())
+                continue;
+
+            if (layerIndex >= animationSlots.size())
+                throw std::runtime_error("Animation layer not present");
+
+            auto found = animationSlots[layerIndex].find(*rect.animationIndex);
+            if (found == animationSlots[layerIndex].end())
+            {
+                throw std::runtime_error(std::format("Animation in layer {} with id {} could not be found!",
+                                                     layerIndex,
+                                                     *rect.animationIndex));
+            }
+
+            const auto& animation = mAnimationLayers[layerIndex][found->second].value;
+            if (animation.points.size() < 2)
+                throw std::runtime_error("Animation paths need at least 2 points");
+
+            // Path points are rect centers in level pixels, the offset matches the body placement above
+            mMovers.add(animation.points,
+                        animation.duration,
+                        animation.phase,
+                        animation.angularVelocity,
+                        {-0.5f * rect.size.x / 32.f, -0.5f},
+                        boxBody);
+            mAnimatedRects.push_back({static_cast<u32>(layerIndex), static_cast<u32>(rectIndex)});
         }
     }
 }
 
-void Level::updateAnimations(sf::Time& gameTime)
+void Level::updateAnimations(sf::Time gameTime, sf::Time fixedStep)
 {
-    for (std::size_t layerIndex = 0; layerIndex < mAnimationLayers.size(); layerIndex++)
+    mMovers.update(gameTime.asSeconds(), 1.f / fixedStep.asSeconds());
+
+    for (std::size_t mover = 0; mover < mAnimatedRects.size(); mover++)
     {
-        for (auto& [id, rect] : mRectLayers[layerIndex])
-        {
-            if (!rect.animationIndex.has_value())
-                continue;
+        const auto& animated = mAnimatedRects[mover];
+        auto& rect = mRectLayers[animated.layer][animated.rect].value;
+
+        rect.position = mMovers.pathPosition(static_cast<u32>(mover)) - (rect.size * 0.5f);
+        rect.rotation = sf::radians(mMovers.bodyAngle(static_cast<u32>(mover)) +
+                                    (mMovers.angularVelocity(static_cast<u32>(mover)) * fixedStep.asSeconds()));
+    }
+}
+
+bool Level::Changes::empty() const
+{
+    return chunks.empty() && !chunkLayout && tilesets.empty() && !tilesetLayout && rebuiltRects == 0 && !rectLayout;
+}
+
+Level::Changes Level::reload(Level fresh)
+{
+    // Edits that were not repaired yet are rebuilt together with what differs from fresh, against the fresh tiles
+    Changes changes;
+    changes.collisionRects = std::exchange(mDirtyTiles, {});
+    reloadTiles(fresh, changes);
+    reloadTilesets(fresh, changes);
+    reloadObjects(fresh, changes);
+    mSourceFiles = std::move(fresh.mSourceFiles);
+    // Edits were made to tiles that no longer exist
+    mTileEdits.clear();
+    mGeneration++;
+
+    return changes;
+}
 
-            auto& animation = findAnimation(layerIndex, *rect.animationIndex);
+void Level::reloadTiles(Level& fresh, Changes& changes)
+{
+    const auto& current = mTiles;
+    auto& incoming = fresh.mTiles;
 
-            if (animation.points.size() != 2)
-                throw std::runtime_error("Only animation paths with exactly 2 points are supported");
+    auto sameRect = [](const Chunk& a, const Chunk& b)
+    { return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height; };
 
+    bool sameLayout = current.size() == incoming.size();
+    for (std::size_t layer = 0; sameLayout && layer < current.size(); layer++)
+        sameLayout = std::ranges::equal(current[layer], incoming[layer], sameRect);
 
-            float t = 2.f * (std::fmod(gameTime.asSeconds(), animation.duration) / animation.duration);
-            if (t >= 1.f)
+    if (!sameLayout)
+    {
+        changes.chunkLayout = true;
+        changes.collisionRects.clear();
+        mTiles = std::move(fresh.mTiles);
+        mChunkGrid = std::move(fresh.mChunkGrid);
+        mChunkRefs = std::move(fresh.mChunkRefs);
+        mTileCollision.reset();
+
+        if (mTilesRegistered)
+        {
+            for (b2Body* body : mTileBodies)
             {
-                t = 2.f - t;
+                if (body != nullptr)
+                    mWorld->DestroyBody(body);
             }
+            mTileBodies.clear();
+            mTileRegions.clear();
+            mTileRegionGrid.clear();
+            mTilesRegistered = false;
 
-            sf::Vector2f pos = {
-                std::lerp(animation.points[0].x, animation.points[1].x, t) - (rect.size.x * 0.5f),
-                std::lerp(animation.points[0].y, animation.points[1].y, t) - (rect.size.y * 0.5f),
-            };
-
-            rect.position = pos;
+            registerTileCollision(*mWorld);
+            changes.rebuiltRegions = mTileRegions.size();
+        }
+        return;
+    }
 
-            b2Body& body = findRectBody(layerIndex, id);
+    for (std::size_t layer = 0; layer < current.size(); layer++)
+    {
+        for (std::size_t chunk = 0; chunk < current[layer].size(); chunk++)
+        {
+            if (current[layer][chunk].tiles != incoming[layer][chunk].tiles &&
+                !std::ranges::equal(current[layer][chunk].data(), incoming[layer][chunk].data()))
+                changes.chunks.push_back({static_cast<u32>(layer), static_cast<u32>(chunk)});
+        }
+    }
 
-            rect.rotation = sf::radians(body.GetAngle() + (animation.angularVelocity / 60.f));
+    if (!changes.chunks.empty())
+        mTileCollision.reset();
 
-            b2Vec2 physicsPos = {rect.position.x / 32.f, ((rect.position.y + (0.5f * rect.size.y)) / 32.f) - 0.5f};
-            b2Vec2 diff = {
-                60.f * (physicsPos.x - body.GetPosition().x),
-                60.f * (physicsPos.y - body.GetPosition().y),
-            };
-            body.SetLinearVelocity(diff);
-            body.SetAngularVelocity(animation.angularVelocity);
+    for (auto [layer, chunk] : changes.chunks)
+    {
+        auto& target = mTiles[layer][chunk];
+        auto before = target.data();
+        auto after = incoming[layer][chunk].data();
+
+        // Only tiles that turned solid or empty change the outlines, gid changes within solid tiles do not
+        sf::Vector2i min{target.width, target.height};
+        sf::Vector2i max{-1, -1};
+        for (int y = 0; y < target.height; y++)
+        {
+            for (int x = 0; x < target.width; x++)
+            {
+                auto offset = static_cast<std::size_t>(x + (y * target.width));
+                if ((before[offset] != 0) == (after[offset] != 0))
+                    continue;
+                min = {std::min(min.x, x), std::min(min.y, y)};
+                max = {std::max(max.x, x), std::max(max.y, y)};
+            }
         }
+        if (max.x >= 0)
+            changes.collisionRects.push_back({{target.x + min.x, target.y + min.y}, max - min + sf::Vector2i{1, 1}});
+
+        target.tiles = std::move(incoming[layer][chunk].tiles);
     }
+
+    changes.rebuiltRegions = rebuildTileCollision(changes.collisionRects);
 }
 
-namespace level::priv
+void Level::reloadTilesets(Level& fresh, Changes& changes)
 {
-auto& findInLayerdContainer(auto& layeredIdContainer, unsigned layerIndex, unsigned id, std::string_view name = "")
-{
-    if (layerIndex >= layeredIdContainer.size())
-        throw std::runtime_error("Animation layer not present");
+    const auto& current = *mTilesets;
+    const auto& incoming = *fresh.mTilesets;
 
-    auto found = std::ranges::find_if(layeredIdContainer[layerIndex],
-                                      [id](const auto& idWrapper) { return idWrapper.id == id; });
+    auto same = [](const Tileset& a, const Tileset& b)
+    {
+        auto size = a.image.getSize();
+        return a.firstGid == b.firstGid && a.tileDim == b.tileDim && a.columns == b.columns &&
+               a.animations == b.animations && size == b.image.getSize() &&
+               std::memcmp(a.image.getPixelsPtr(), b.image.getPixelsPtr(), std::size_t{size.x} * size.y * 4) == 0;
+    };
 
-    if (found == layeredIdContainer[layerIndex].end())
-        throw std::runtime_error(std::format("{} in layer {} with id {} could not be found!", name, layerIndex, id));
+    for (std::size_t index = 0; index < incoming.size(); index++)
+    {
+        if (index >= current.size() || !same(current[index], incoming[index]))
+            changes.tilesets.push_back(static_cast<u32>(index));
+    }
 
-    return found->value;
+    changes.tilesetLayout = current.size() != incoming.size();
+    if (!changes.tilesets.empty() || changes.tilesetLayout)
+        mTilesets = fresh.mTilesets;
 }
-} // namespace level::priv
 
-Level::Animation& Level::findAnimation(unsigned layerIndex, unsigned animationId)
+void Level::reloadObjects(Level& fresh, Changes& changes)
 {
-    return level::priv::findInLayerdContainer(mAnimationLayers, layerIndex, animationId, "Animation");
-}
+    auto sameAnimation = [](const IdWrapper<Animation>& a, const IdWrapper<Animation>& b)
+    {
+        return a.id == b.id && a.value.points == b.value.points && a.value.duration == b.value.duration &&
+               a.value.phase == b.value.phase && a.value.angularVelocity == b.value.angularVelocity;
+    };
+    // Animated rects are positioned by their mover, only what the mover is created from matters
+    auto sameRole = [](const IdWrapper<Rect>& a, const IdWrapper<Rect>& b)
+    {
+        if (a.id != b.id || a.value.animationIndex != b.value.animationIndex)
+            return false;
+        return !a.value.animationIndex.has_value() || a.value.size == b.value.size;
+    };
+
+    bool sameLayout = mAnimationLayers.size() == fresh.mAnimationLayers.size() &&
+                      mRectLayers.size() == fresh.mRectLayers.size();
+    for (std::size_t layer = 0; sameLayout && layer < mAnimationLayers.size(); layer++)
+        sameLayout = std::ranges::equal(mAnimationLayers[layer], fresh.mAnimationLayers[layer], sameAnimation);
+    for (std::size_t layer = 0; sameLayout && layer < mRectLayers.size(); layer++)
+        sameLayout = std::ranges::equal(mRectLayers[layer], fresh.mRectLayers[layer], sameRole);
+
+    if (!sameLayout)
+    {
+        changes.rectLayout = true;
 
-b2Body& Level::findRectBody(unsigned layerIndex, unsigned rectId)
-{
-    return *level::priv::findInLayerdContainer(mRectBodyLayers, layerIndex, rectId, "Rect Physics Body");
+        if (mRectsRegistered)
+        {
+            for (const auto& layer : mRectBodyLayers)
+            {
+                for (const auto& [id, body] : layer)
+                    mWorld->DestroyBody(body);
+            }
+        }
+        mRectBodyLayers.clear();
+        mAnimatedRects.clear();
+        mMovers = MoverSystem{};
+        mRectLayers = std::move(fresh.mRectLayers);
+        mAnimationLayers = std::move(fresh.mAnimationLayers);
+
+        if (mRectsRegistered)
+        {
+            mRectsRegistered = false;
+            registerRectCollisions(*mWorld);
+        }
+        return;
+    }
+
+    // Only static rects can differ from here on
+    u32 bodyId = 0;
+    for (std::size_t layer = 0; layer < mRectLayers.size(); layer++)
+    {
+        for (std::size_t index = 0; index < mRectLayers[layer].size(); index++, bodyId++)
+        {
+            auto& rect = mRectLayers[layer][index].value;
+            const auto& incoming = fresh.mRectLayers[layer][index].value;
+            bool moved = rect.position != incoming.position || rect.size != incoming.size ||
+                         rect.rotation != incoming.rotation;
+            if (rect.animationIndex.has_value() || !moved)
+                continue;
+
+            rect = incoming;
+            changes.rebuiltRects++;
+
+            if (mRectsRegistered)
+            {
+                auto& body = mRectBodyLayers[layer][index].value;
+                mWorld->DestroyBody(body);
+                body = createRectBody(*mWorld, rect, bodyId);
+            }
+        }
+    }
 }
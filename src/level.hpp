@@ -1,15 +1,28 @@
 #pragma once
 
 #include "SFML/Graphics/Image.hpp"
+#include "SFML/Graphics/Rect.hpp"
 #include "SFML/System/Vector2.hpp"
+#include "chunkTiles.hpp"
+#include "moverSystem.hpp"
+#include "spatialGrid.hpp"
 #include "types.hpp"
 
 #include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
 #include <vector>
 
 class b2World;
 class b2Body;
 
+namespace CollisionBaker
+{
+struct RegionCollision;
+}
+
 namespace sf
 {
 class Time;
@@ -24,7 +37,11 @@ public:
         int y{};
         int width{};
         int height{};
-        std::vector<u32> data;
+        // Shared by copies of the chunk, see ChunkTiles::makeUnique
+        std::shared_ptr<ChunkTiles> tiles;
+
+        // Decodes the tiles on first access
+        std::span<const u32> data() const { return tiles->get(); }
     };
     struct Rect
     {
@@ -38,6 +55,8 @@ public:
     {
         std::vector<sf::Vector2f> points;
         float duration{};
+        // Offset into the cycle as a fraction of duration
+        float phase{};
         float angularVelocity{};
     };
 
@@ -48,46 +67,181 @@ public:
         Val value;
     };
 
+    // Frame of a Tiled tile animation
+    struct TileFrame
+    {
+        // Local id of the tile shown
+        u32 tile{};
+        u32 durationMs{};
+
+        bool operator==(const TileFrame&) const = default;
+    };
+
+    struct TileAnimation
+    {
+        // Local id of the animated tile
+        u32 tile{};
+        std::vector<TileFrame> frames;
+
+        bool operator==(const TileAnimation&) const = default;
+    };
+
     struct Tileset
     {
         sf::Image image;
         unsigned firstGid{};
         sf::Vector2u tileDim;
         u32 columns{};
+        std::vector<TileAnimation> animations;
+    };
+
+    struct ChunkIndex
+    {
+        u32 layer{};
+        u32 chunk{};
+    };
+
+    // Tile written by setTile, in tile coordinates
+    struct TileEdit
+    {
+        u32 layer{};
+        int x{};
+        int y{};
+        u32 gid{};
     };
 
+    // Tile region bodies store their region index in their userData, see CollisionBaker::regions, rect bodies
+    // their index across all rect layers with this flag. The id stays the same when a body is rebuilt.
+    static constexpr std::uintptr_t rectBodyFlag = std::uintptr_t{1} << 30;
+
     void addChunk(unsigned layer, Chunk chunk);
     void addRect(unsigned layer, unsigned id, Rect rect);
     void addAnimation(unsigned layer, unsigned id, Animation animation);
     void addTileset(Tileset tileset);
 
+    // Unregistered copy of this level. Chunk tiles, tilesets and baked tile collision are shared between all
+    // instances, setTile copies only the chunk it changes.
+    Level instance() const;
+
+    // Bakes tile collision outlines for registerCollision, instances created afterwards reuse the result
+    void bakeCollision();
+
     std::vector<std::vector<IdWrapper<Rect>>>& getRects() { return mRectLayers; }
 
+    // Copies of the chunks keep their tiles alive and unchanged for readers on other threads
     const std::vector<std::vector<Chunk>>& getTileLayers() const { return mTiles; }
+    // Chunks of all layers overlapping area, in tile coordinates
+    void chunksIn(sf::IntRect area, std::vector<const Chunk*>& result) const;
+
+    // Changes one tile, gid 0 clears it. Returns false if no chunk of layer contains the tile. Collision is only
+    // repaired by repairTileCollision, so a burst of edits rebakes every affected region once.
+    bool setTile(unsigned layer, int x, int y, u32 gid);
+    // Tiles that turned solid or empty since the last repairTileCollision
+    std::span<const sf::IntRect> dirtyTiles() const { return mDirtyTiles; }
+    // Rebakes the registered tile collision around dirtyTiles and clears them, returns the number of regions
+    std::size_t repairTileCollision();
+
+    // Once enabled, setTile logs its edits for consumers that keep their own copy of the tiles, like renderers on
+    // another thread. The consumer clears the log after reading it.
+    void recordTileEdits(bool record) { mRecordTileEdits = record; }
+    const std::vector<TileEdit>& tileEdits() const { return mTileEdits; }
+    void clearTileEdits() { mTileEdits.clear(); }
+    // Incremented by reload, edits of an older generation were made to tiles that no longer exist
+    u64 generation() const { return mGeneration; }
     const std::vector<std::vector<IdWrapper<Rect>>>& getRectLayers() const { return mRectLayers; }
     const std::vector<std::vector<IdWrapper<Animation>>>& getPolylineLayers() const { return mAnimationLayers; }
 
-    const std::vector<Tileset>& getTilesets() const { return mTilesets; }
+    const std::vector<Tileset>& getTilesets() const { return *mTilesets; }
 
     const std::filesystem::path& tilesetPath() const { return mTilesetPath; }
 
+    // Rect driven by the mover with the same index
+    struct AnimatedRect
+    {
+        u32 layer{};
+        u32 rect{};
+    };
+
+    // Filled by registerCollision, in layer and rect order
+    const std::vector<AnimatedRect>& animatedRects() const { return mAnimatedRects; }
+
+    // Error if a rect refers to an animation of its layer that does not exist or has fewer than 2 points, which
+    // registerCollision throws on. Loaders check this, so a broken file never replaces a running level.
+    std::optional<std::string> checkAnimations() const;
+
     void registerCollision(b2World& world);
+    // registerCollision without the tiles, for when their collision is streamed in separately
+    void registerRectCollisions(b2World& world);
+
+    void updateAnimations(sf::Time gameTime, sf::Time fixedStep);
 
-    void updateAnimations(sf::Time& gameTime);
+    // What reload changed, for updating renderers
+    struct Changes
+    {
+        // Chunks whose tiles changed, only filled if the chunk layout stayed the same
+        std::vector<ChunkIndex> chunks;
+        // Chunks were added, removed or moved, so every chunk index may refer to a different chunk
+        bool chunkLayout{};
+        // Tiles whose collision was rebuilt in tile coordinates, only filled if the chunk layout stayed the same:
+        // edits that were not repaired yet and the bounds of what turned solid or empty in each of chunks
+        std::vector<sf::IntRect> collisionRects;
+        std::size_t rebuiltRegions{};
+        // Tilesets whose image, tile size or animations changed, and ones that were added
+        std::vector<u32> tilesets;
+        // Tilesets were added or removed
+        bool tilesetLayout{};
+        // Static rects that were moved or resized
+        std::size_t rebuiltRects{};
+        // Rects or animations were added, removed or changed their animation, so every rect was rebuilt
+        bool rectLayout{};
+
+        bool empty() const;
+    };
+
+    // Adopts fresh, a newer version of this level, and rebuilds the collision of only what changed. Other bodies in
+    // the world, like ships, are left alone.
+    Changes reload(Level fresh);
+
+    // Files the level was loaded from, for watching them
+    const std::vector<std::filesystem::path>& sourceFiles() const { return mSourceFiles; }
+    void addSourceFile(std::filesystem::path path);
 
 private:
     void registerTileCollision(b2World& world);
-    void registerRectCollisions(b2World& world);
+    // Rebakes every region whose outlines depend on tiles within dirty, returns the number of regions
+    std::size_t rebuildTileCollision(std::span<const sf::IntRect> dirty);
 
-    Animation& findAnimation(unsigned layerIndex, unsigned animationId);
-    b2Body& findRectBody(unsigned layerIndex, unsigned rectId);
+    void reloadTiles(Level& fresh, Changes& changes);
+    void reloadTilesets(Level& fresh, Changes& changes);
+    void reloadObjects(Level& fresh, Changes& changes);
 
     std::vector<std::vector<Chunk>> mTiles;
+    // Shared between instances, copied before modification if another instance still uses them
+    std::shared_ptr<std::vector<Tileset>> mTilesets{std::make_shared<std::vector<Tileset>>()};
+    std::shared_ptr<const std::vector<CollisionBaker::RegionCollision>> mTileCollision;
+    // Chunks by their rect in tile coordinates, items index mChunkRefs
+    SpatialGrid mChunkGrid{16.f};
+    std::vector<ChunkIndex> mChunkRefs;
+
     std::vector<std::vector<IdWrapper<Rect>>> mRectLayers;
     std::vector<std::vector<IdWrapper<Animation>>> mAnimationLayers;
-    std::vector<Tileset> mTilesets;
 
+    // World the collision was registered with
+    b2World* mWorld{};
+    bool mTilesRegistered{};
+    bool mRectsRegistered{};
+    // One entry per distinct chunk rect, regions without outlines have no body
+    std::vector<sf::IntRect> mTileRegions;
     std::vector<b2Body*> mTileBodies;
+    // mTileRegions in tile coordinates, items index mTileRegions
+    SpatialGrid mTileRegionGrid{16.f};
+    std::vector<sf::IntRect> mDirtyTiles;
+    bool mRecordTileEdits{};
+    std::vector<TileEdit> mTileEdits;
+    u64 mGeneration{};
     std::vector<std::vector<IdWrapper<b2Body*>>> mRectBodyLayers;
+    std::vector<AnimatedRect> mAnimatedRects;
+    MoverSystem mMovers;
     std::filesystem::path mTilesetPath{"../../data/tilesets/glozzom24-32x.png"};
+    std::vector<std::filesystem::path> mSourceFiles;
 };
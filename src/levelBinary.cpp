@@ -0,0 +1,565 @@
+#include "levelBinary.hpp"
+
+#include "mappedFile.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <fstream>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include <cstring>
+
+static_assert(std::endian::native == std::endian::little, "The compiled level format is little endian");
+
+namespace LevelBinary
+{
+namespace
+{
+// All sections start 16 byte aligned, records are plain structs stored back to back
+constexpr std::size_t sectionAlignment = 16;
+// Bounds the layer tables a header can make the reader allocate, Tiled maps have a handful of layers
+constexpr u32 maxLayerCount = 4096;
+
+struct Header
+{
+    u32 magic{};
+    u32 version{};
+    u32 chunkCount{};
+    u32 rectCount{};
+    u32 animationCount{};
+    u32 pointCount{};
+    u32 tilesetCount{};
+    u32 tileAnimationCount{};
+    u32 tileFrameCount{};
+    u32 tileLayerCount{};
+    u32 rectLayerCount{};
+    u32 animationLayerCount{};
+    u32 sourceFileCount{};
+    u32 reserved{};
+    u64 chunkOffset{};
+    u64 rectOffset{};
+    u64 animationOffset{};
+    u64 pointOffset{};
+    u64 tilesetOffset{};
+    u64 tileAnimationOffset{};
+    u64 tileFrameOffset{};
+    u64 sourceFileOffset{};
+    u64 fileSize{};
+};
+
+struct ChunkRecord
+{
+    u32 layer{};
+    i32 x{};
+    i32 y{};
+    i32 width{};
+    i32 height{};
+    u32 reserved{};
+    u64 dataOffset{};
+};
+
+struct RectRecord
+{
+    u32 layer{};
+    u32 id{};
+    float positionX{};
+    float positionY{};
+    float sizeX{};
+    float sizeY{};
+    float rotation{};
+    u32 hasAnimation{};
+    u32 animationIndex{};
+};
+
+struct AnimationRecord
+{
+    u32 layer{};
+    u32 id{};
+    u32 firstPoint{};
+    u32 pointCount{};
+    float duration{};
+    float phase{};
+    float angularVelocity{};
+    u32 reserved{};
+};
+
+struct PointRecord
+{
+    float x{};
+    float y{};
+};
+
+struct TilesetRecord
+{
+    u32 firstGid{};
+    u32 tileWidth{};
+    u32 tileHeight{};
+    u32 columns{};
+    u32 imageWidth{};
+    u32 imageHeight{};
+    u64 pixelOffset{};
+    u32 firstTileAnimation{};
+    u32 tileAnimationCount{};
+};
+
+struct TileAnimationRecord
+{
+    u32 tile{};
+    u32 firstFrame{};
+    u32 frameCount{};
+    u32 reserved{};
+};
+
+struct TileFrameRecord
+{
+    u32 tile{};
+    u32 durationMs{};
+};
+
+// Path relative to the compiled file, stored as generic UTF-8 bytes
+struct SourceFileRecord
+{
+    u64 pathOffset{};
+    u32 pathLength{};
+    u32 reserved{};
+};
+
+class Writer
+{
+public:
+    std::size_t align()
+    {
+        mBuffer.resize((mBuffer.size() + sectionAlignment - 1) / sectionAlignment * sectionAlignment);
+        return mBuffer.size();
+    }
+
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    std::size_t append(std::span<const T> values)
+    {
+        auto offset = mBuffer.size();
+        mBuffer.resize(offset + values.size_bytes());
+        if (!values.empty())
+            std::memcpy(mBuffer.data() + offset, values.data(), values.size_bytes());
+        return offset;
+    }
+
+    template <typename T>
+    void patch(std::size_t offset, const T& value)
+    {
+        std::memcpy(mBuffer.data() + offset, &value, sizeof(T));
+    }
+
+    const std::vector<std::byte>& buffer() const { return mBuffer; }
+
+private:
+    std::vector<std::byte> mBuffer;
+};
+
+class Reader
+{
+public:
+    explicit Reader(std::span<const std::byte> bytes) : mBytes{bytes} {}
+
+    bool valid(u64 offset, u64 size) const { return offset <= mBytes.size() && size <= mBytes.size() - offset; }
+
+    template <typename T>
+    T read(u64 offset) const
+    {
+        T value;
+        std::memcpy(&value, mBytes.data() + offset, sizeof(T));
+        return value;
+    }
+
+    const std::byte* at(u64 offset) const { return mBytes.data() + offset; }
+
+private:
+    std::span<const std::byte> mBytes;
+};
+
+std::string corrupt(const std::filesystem::path& path)
+{
+    return std::format("Compiled level file is corrupt: {}", path.string());
+}
+
+// Checks magic, version and that every section lies inside the file
+std::expected<Header, std::string> readHeader(const Reader& reader, u64 size, const std::filesystem::path& path)
+{
+    if (!reader.valid(0, sizeof(Header)))
+        return std::unexpected(std::format("Compiled level file is truncated: {}", path.string()));
+
+    auto header = reader.read<Header>(0);
+    if (header.magic != magic)
+        return std::unexpected(std::format("Not a compiled level file: {}", path.string()));
+    if (header.version != version)
+        return std::unexpected(std::format("Compiled level file {} has version {}, expected {}. Recompile it.",
+                                           path.string(),
+                                           header.version,
+                                           version));
+    if (header.fileSize != size ||
+        !reader.valid(header.chunkOffset, u64{header.chunkCount} * sizeof(ChunkRecord)) ||
+        !reader.valid(header.tilesetOffset, u64{header.tilesetCount} * sizeof(TilesetRecord)) ||
+        !reader.valid(header.tileAnimationOffset, u64{header.tileAnimationCount} * sizeof(TileAnimationRecord)) ||
+        !reader.valid(header.tileFrameOffset, u64{header.tileFrameCount} * sizeof(TileFrameRecord)) ||
+        !reader.valid(header.rectOffset, u64{header.rectCount} * sizeof(RectRecord)) ||
+        !reader.valid(header.animationOffset, u64{header.animationCount} * sizeof(AnimationRecord)) ||
+        !reader.valid(header.pointOffset, u64{header.pointCount} * sizeof(PointRecord)) ||
+        !reader.valid(header.sourceFileOffset, u64{header.sourceFileCount} * sizeof(SourceFileRecord)) ||
+        header.tileLayerCount > maxLayerCount || header.rectLayerCount > maxLayerCount ||
+        header.animationLayerCount > maxLayerCount)
+    {
+        return std::unexpected(corrupt(path));
+    }
+
+    return header;
+}
+
+std::expected<std::vector<std::filesystem::path>, std::string> readSourceFiles(const Reader& reader,
+                                                                               const Header& header,
+                                                                               const std::filesystem::path& path)
+{
+    std::vector<std::filesystem::path> sourceFiles;
+    sourceFiles.reserve(header.sourceFileCount);
+    for (u32 i = 0; i < header.sourceFileCount; i++)
+    {
+        auto record =
+            reader.read<SourceFileRecord>(header.sourceFileOffset + (u64{i} * sizeof(SourceFileRecord)));
+        if (!reader.valid(record.pathOffset, record.pathLength))
+            return std::unexpected(corrupt(path));
+
+        std::u8string relative(reinterpret_cast<const char8_t*>(reader.at(record.pathOffset)), record.pathLength);
+        sourceFiles.push_back(path.parent_path() / std::filesystem::path(relative));
+    }
+    return sourceFiles;
+}
+} // namespace
+
+std::optional<std::string> toFile(const Level& level, const std::filesystem::path& path)
+{
+    Writer writer;
+    Header header{.magic = magic, .version = version};
+    writer.append(std::span<const Header>(&header, 1));
+
+    // Payloads first, so the record sections can be written in one go afterwards
+    std::vector<ChunkRecord> chunks;
+    const auto& tileLayers = level.getTileLayers();
+    for (std::size_t layerIndex = 0; layerIndex < tileLayers.size(); layerIndex++)
+    {
+        for (const auto& chunk : tileLayers[layerIndex])
+        {
+            // A chunk that failed to decode reads as empty, compiling it would hide the error for good
+            if (auto error = chunk.tiles->error(); error.has_value())
+                return *error;
+
+            auto tiles = chunk.data();
+            if (tiles.size() != static_cast<std::size_t>(chunk.width) * static_cast<std::size_t>(chunk.height))
+                return std::format("Chunk at {}, {} has an invalid data size", chunk.x, chunk.y);
+
+            writer.align();
+            chunks.push_back({static_cast<u32>(layerIndex),
+                              chunk.x,
+                              chunk.y,
+                              chunk.width,
+                              chunk.height,
+                              0,
+                              writer.append(tiles)});
+        }
+    }
+
+    std::vector<TilesetRecord> tilesets;
+    std::vector<TileAnimationRecord> tileAnimations;
+    std::vector<TileFrameRecord> tileFrames;
+    for (const auto& tileset : level.getTilesets())
+    {
+        auto imageSize = tileset.image.getSize();
+        std::span<const u8> pixels(tileset.image.getPixelsPtr(),
+                                   static_cast<std::size_t>(imageSize.x) * imageSize.y * 4);
+
+        writer.align();
+        tilesets.push_back({tileset.firstGid,
+                            tileset.tileDim.x,
+                            tileset.tileDim.y,
+                            tileset.columns,
+                            imageSize.x,
+                            imageSize.y,
+                            writer.append(pixels),
+                            static_cast<u32>(tileAnimations.size()),
+                            static_cast<u32>(tileset.animations.size())});
+
+        for (const auto& animation : tileset.animations)
+        {
+            tileAnimations.push_back({animation.tile,
+                                      static_cast<u32>(tileFrames.size()),
+                                      static_cast<u32>(animation.frames.size()),
+                                      0});
+            for (auto frame : animation.frames)
+                tileFrames.push_back({frame.tile, frame.durationMs});
+        }
+    }
+
+    // Relative to the compiled file, so the pair can move together
+    std::vector<SourceFileRecord> sourceFiles;
+    auto compiledDirectory = std::filesystem::absolute(path).parent_path();
+    for (const auto& file : level.sourceFiles())
+    {
+        auto relative = std::filesystem::absolute(file).lexically_relative(compiledDirectory).generic_u8string();
+        sourceFiles.push_back({writer.append(std::span<const char8_t>(relative)),
+                               static_cast<u32>(relative.size()),
+                               0});
+    }
+
+    std::vector<RectRecord> rects;
+    const auto& rectLayers = level.getRectLayers();
+    for (std::size_t layerIndex = 0; layerIndex < rectLayers.size(); layerIndex++)
+    {
+        for (const auto& [id, rect] : rectLayers[layerIndex])
+        {
+            rects.push_back({static_cast<u32>(layerIndex),
+                             id,
+                             rect.position.x,
+                             rect.position.y,
+                             rect.size.x,
+                             rect.size.y,
+                             rect.rotation.asRadians(),
+                             rect.animationIndex.has_value() ? 1u : 0u,
+                             rect.animationIndex.value_or(0)});
+        }
+    }
+
+    std::vector<AnimationRecord> animations;
+    std::vector<PointRecord> points;
+    const auto& animationLayers = level.getPolylineLayers();
+    for (std::size_t layerIndex = 0; layerIndex < animationLayers.size(); layerIndex++)
+    {
+        for (const auto& [id, animation] : animationLayers[layerIndex])
+        {
+            animations.push_back({static_cast<u32>(layerIndex),
+                                  id,
+                                  static_cast<u32>(points.size()),
+                                  static_cast<u32>(animation.points.size()),
+                                  animation.duration,
+                                  animation.phase,
+                                  animation.angularVelocity,
+                                  0});
+            for (auto point : animation.points)
+                points.push_back({point.x, point.y});
+        }
+    }
+
+    header.chunkCount = static_cast<u32>(chunks.size());
+    header.chunkOffset = writer.align();
+    writer.append(std::span<const ChunkRecord>(chunks));
+
+    header.tilesetCount = static_cast<u32>(tilesets.size());
+    header.tilesetOffset = writer.align();
+    writer.append(std::span<const TilesetRecord>(tilesets));
+
+    header.tileAnimationCount = static_cast<u32>(tileAnimations.size());
+    header.tileAnimationOffset = writer.align();
+    writer.append(std::span<const TileAnimationRecord>(tileAnimations));
+
+    header.tileFrameCount = static_cast<u32>(tileFrames.size());
+    header.tileFrameOffset = writer.align();
+    writer.append(std::span<const TileFrameRecord>(tileFrames));
+
+    header.rectCount = static_cast<u32>(rects.size());
+    header.rectOffset = writer.align();
+    writer.append(std::span<const RectRecord>(rects));
+
+    header.animationCount = static_cast<u32>(animations.size());
+    header.animationOffset = writer.align();
+    writer.append(std::span<const AnimationRecord>(animations));
+
+    header.pointCount = static_cast<u32>(points.size());
+    header.pointOffset = writer.align();
+    writer.append(std::span<const PointRecord>(points));
+
+    header.sourceFileCount = static_cast<u32>(sourceFiles.size());
+    header.sourceFileOffset = writer.align();
+    writer.append(std::span<const SourceFileRecord>(sourceFiles));
+
+    header.tileLayerCount = static_cast<u32>(tileLayers.size());
+    header.rectLayerCount = static_cast<u32>(rectLayers.size());
+    header.animationLayerCount = static_cast<u32>(animationLayers.size());
+
+    header.fileSize = writer.align();
+    writer.patch(0, header);
+
+    // Levels loaded from path may still map it, so it is replaced instead of overwritten
+    auto temporaryPath = std::filesystem::path(path).concat(".tmp");
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return std::format("Could not open compiled level file for writing: {}", temporaryPath.string());
+
+        file.write(reinterpret_cast<const char*>(writer.buffer().data()),
+                   static_cast<std::streamsize>(writer.buffer().size()));
+        if (!file.flush())
+            return std::format("Could not write compiled level file: {}", temporaryPath.string());
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error)
+        return std::format("Could not replace compiled level file {}: {}", path.string(), error.message());
+
+    return {};
+}
+
+std::expected<Level, std::string> fromFile(const std::filesystem::path& path)
+{
+    auto mapped = MappedFile::open(path);
+    if (!mapped.has_value())
+        return std::unexpected(mapped.error());
+    auto file = std::make_shared<const MappedFile>(std::move(*mapped));
+
+    Reader reader(file->bytes());
+    auto header = readHeader(reader, file->bytes().size(), path);
+    if (!header.has_value())
+        return std::unexpected(header.error());
+
+    auto sourceFiles = readSourceFiles(reader, *header, path);
+    if (!sourceFiles.has_value())
+        return std::unexpected(sourceFiles.error());
+
+    Level level;
+    for (auto& file : *sourceFiles)
+        level.addSourceFile(std::move(file));
+
+    for (u32 i = 0; i < header->chunkCount; i++)
+    {
+        auto record = reader.read<ChunkRecord>(header->chunkOffset + (u64{i} * sizeof(ChunkRecord)));
+        if (record.layer >= header->tileLayerCount || record.width < 0 || record.height < 0)
+            return std::unexpected(corrupt(path));
+
+        auto tileCount = static_cast<std::size_t>(record.width) * static_cast<std::size_t>(record.height);
+        if (!reader.valid(record.dataOffset, tileCount * sizeof(u32)))
+            return std::unexpected(corrupt(path));
+
+        // Copied out of the mapping on first access, the chunks keep the file mapped until then
+        auto copyTiles = [file, offset = record.dataOffset](std::span<u32> tiles) -> std::optional<std::string>
+        {
+            std::memcpy(tiles.data(), file->bytes().data() + offset, tiles.size_bytes());
+            return {};
+        };
+        level.addChunk(record.layer,
+                       {record.x,
+                        record.y,
+                        record.width,
+                        record.height,
+                        std::make_shared<ChunkTiles>(tileCount, std::move(copyTiles))});
+    }
+
+    for (u32 i = 0; i < header->tilesetCount; i++)
+    {
+        auto record = reader.read<TilesetRecord>(header->tilesetOffset + (u64{i} * sizeof(TilesetRecord)));
+
+        auto byteCount = u64{record.imageWidth} * record.imageHeight * 4;
+        if (!reader.valid(record.pixelOffset, byteCount) ||
+            u64{record.firstTileAnimation} + record.tileAnimationCount > header->tileAnimationCount ||
+            u64{record.columns} * record.tileWidth > record.imageWidth)
+            return std::unexpected(corrupt(path));
+
+        std::vector<Level::TileAnimation> animations(record.tileAnimationCount);
+        for (u32 animationIndex = 0; animationIndex < record.tileAnimationCount; animationIndex++)
+        {
+            auto animationRecord = reader.read<TileAnimationRecord>(
+                header->tileAnimationOffset +
+                (u64{record.firstTileAnimation + animationIndex} * sizeof(TileAnimationRecord)));
+            if (u64{animationRecord.firstFrame} + animationRecord.frameCount > header->tileFrameCount)
+                return std::unexpected(corrupt(path));
+
+            auto& animation = animations[animationIndex];
+            animation.tile = animationRecord.tile;
+            for (u32 frame = 0; frame < animationRecord.frameCount; frame++)
+            {
+                auto frameRecord = reader.read<TileFrameRecord>(
+                    header->tileFrameOffset + (u64{animationRecord.firstFrame + frame} * sizeof(TileFrameRecord)));
+                animation.frames.push_back({frameRecord.tile, frameRecord.durationMs});
+            }
+        }
+
+        level.addTileset(Level::Tileset{
+            sf::Image({record.imageWidth, record.imageHeight},
+                      reinterpret_cast<const u8*>(reader.at(record.pixelOffset))),
+            record.firstGid,
+            {record.tileWidth, record.tileHeight},
+            record.columns,
+            std::move(animations),
+        });
+    }
+
+    for (u32 i = 0; i < header->rectCount; i++)
+    {
+        auto record = reader.read<RectRecord>(header->rectOffset + (u64{i} * sizeof(RectRecord)));
+        if (record.layer >= header->rectLayerCount)
+            return std::unexpected(corrupt(path));
+
+        level.addRect(record.layer,
+                      record.id,
+                      Level::Rect{{record.positionX, record.positionY},
+                                  {record.sizeX, record.sizeY},
+                                  sf::radians(record.rotation),
+                                  record.hasAnimation != 0 ? std::optional<unsigned>(record.animationIndex)
+                                                           : std::nullopt});
+    }
+
+    for (u32 i = 0; i < header->animationCount; i++)
+    {
+        auto record = reader.read<AnimationRecord>(header->animationOffset + (u64{i} * sizeof(AnimationRecord)));
+        if (record.layer >= header->animationLayerCount ||
+            u64{record.firstPoint} + record.pointCount > header->pointCount)
+            return std::unexpected(corrupt(path));
+
+        Level::Animation animation;
+        animation.points.reserve(record.pointCount);
+        for (u32 p = 0; p < record.pointCount; p++)
+        {
+            auto point = reader.read<PointRecord>(header->pointOffset +
+                                                  (u64{record.firstPoint + p} * sizeof(PointRecord)));
+            animation.points.emplace_back(point.x, point.y);
+        }
+        animation.duration = record.duration;
+        animation.phase = record.phase;
+        animation.angularVelocity = record.angularVelocity;
+
+        level.addAnimation(record.layer, record.id, std::move(animation));
+    }
+
+    if (auto error = level.checkAnimations(); error.has_value())
+        return std::unexpected(*error);
+
+    return level;
+}
+
+bool isCurrent(const std::filesystem::path& path)
+{
+    auto mapped = MappedFile::open(path);
+    if (!mapped.has_value())
+        return false;
+
+    Reader reader(mapped->bytes());
+    auto header = readHeader(reader, mapped->bytes().size(), path);
+    if (!header.has_value())
+        return false;
+
+    auto sourceFiles = readSourceFiles(reader, *header, path);
+    if (!sourceFiles.has_value() || sourceFiles->empty())
+        return false;
+
+    std::error_code error;
+    auto compiledTime = std::filesystem::last_write_time(path, error);
+    if (error)
+        return false;
+
+    return std::ranges::all_of(*sourceFiles,
+                               [&](const std::filesystem::path& file)
+                               {
+                                   auto sourceTime = std::filesystem::last_write_time(file, error);
+                                   return !error && sourceTime <= compiledTime;
+                               });
+}
+} // namespace LevelBinary
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <expected>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include "level.hpp"
+
+// Compiled level format written by lumiax_level_compiler. Chunks are stored as flat u32 arrays and tilesets as
+// decoded RGBA pixels, so loading is a memory mapping plus one copy per chunk and tileset.
+namespace LevelBinary
+{
+constexpr u32 magic = 0x4c584d4c; // "LMXL"
+constexpr u32 version = 4;
+
+std::optional<std::string> toFile(const Level& level, const std::filesystem::path& path);
+std::expected<Level, std::string> fromFile(const std::filesystem::path& path);
+// True if path is a compiled level of the current version that is at least as new as every file it was compiled from
+bool isCurrent(const std::filesystem::path& path);
+} // namespace LevelBinary
@@ -0,0 +1,87 @@
+#include "levelBinary.hpp"
+#include "levelParser.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <charconv>
+#include <iostream>
+#include <print>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+template <typename Loader>
+void benchmarkLoad(std::string_view name, int iterations, Loader&& loader)
+{
+    std::vector<double> samples;
+    samples.reserve(static_cast<std::size_t>(iterations));
+
+    for (int i = 0; i < iterations; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto level = loader();
+        auto end = std::chrono::steady_clock::now();
+
+        if (!level.has_value())
+        {
+            std::println(std::cerr, "{} load failed: {}", name, level.error());
+            return;
+        }
+
+        samples.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+
+    std::ranges::sort(samples);
+    std::println("{:>6}: min {:10.1f} us  median {:10.1f} us  max {:10.1f} us",
+                 name,
+                 samples.front(),
+                 samples[samples.size() / 2],
+                 samples.back());
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::span args(argv, static_cast<std::size_t>(argc));
+
+    if (args.size() != 3 && !(args.size() == 5 && std::string_view(args[3]) == "--bench"))
+    {
+        std::println(std::cerr, "Usage: {} <level.json> <output.lvl> [--bench <iterations>]", args[0]);
+        return 1;
+    }
+
+    std::filesystem::path input = args[1];
+    std::filesystem::path output = args[2];
+
+    auto level = LevelParser::fromFile(input);
+    if (!level.has_value())
+    {
+        std::println(std::cerr, "Failed to load level: {}", level.error());
+        return 1;
+    }
+
+    if (auto error = LevelBinary::toFile(*level, output); error.has_value())
+    {
+        std::println(std::cerr, "Failed to write compiled level: {}", *error);
+        return 1;
+    }
+
+    std::println("Compiled {} -> {} ({} bytes)", input.string(), output.string(), std::filesystem::file_size(output));
+
+    if (args.size() == 5)
+    {
+        std::string_view iterationArg(args[4]);
+        int iterations{};
+        auto [ptr, ec] = std::from_chars(iterationArg.data(), iterationArg.data() + iterationArg.size(), iterations);
+        if (ec != std::errc{} || iterations <= 0)
+        {
+            std::println(std::cerr, "Invalid iteration count: {}", iterationArg);
+            return 1;
+        }
+
+        benchmarkLoad("json", iterations, [&] { return LevelParser::fromFile(input); });
+        benchmarkLoad("binary", iterations, [&] { return LevelBinary::fromFile(output); });
+    }
+}
@@ -3,12 +3,12 @@
 #include "SFML/Graphics/Image.hpp"
 #include "SFML/System/Vector2.hpp"
 #include "nlohmann/json.hpp"
+#include "tileDecoder.hpp"
 
 #include <fstream>
 
 namespace LevelParser
 {
-std::optional<std::string> parseLayers(Level& level, nlohmann::json& levelFile);
 std::optional<std::string> parseTilesets(Level& level, nlohmann::json& levelFile, const std::filesystem::path& levelPath);
 
 std::expected<Level, std::string> fromFile(const std::filesystem::path& path)
@@ -22,6 +22,7 @@ std::expected<Level, std::string> fromFile(const std::filesystem::path& path)
     file >> levelFile;
 
     Level level;
+    level.addSourceFile(path);
 
     if (auto error = parseLayers(level, levelFile); error.has_value())
         return std::unexpected(*error);
@@ -29,26 +30,67 @@ std::expected<Level, std::string> fromFile(const std::filesystem::path& path)
     if (auto error = parseTilesets(level, levelFile, path); error.has_value())
         return std::unexpected(*error);
 
+    if (auto error = level.checkAnimations(); error.has_value())
+        return std::unexpected(*error);
+
     return level;
 }
 
 std::optional<std::string> parseLayers(Level& level, nlohmann::json& levelFile)
 {
-    for (const auto& layer : levelFile["layers"])
+    for (auto& layer : levelFile["layers"])
     {
         std::string type = layer["type"];
         unsigned layerIndex = layer["id"].get<unsigned>() - 1;
 
         if (type == "tilelayer")
         {
-            for (const auto& chunk : layer["chunks"])
+            std::string encoding = layer.value("encoding", std::string{"csv"});
+            if (encoding != "csv" && encoding != "base64")
+                return "Unsupported tile layer encoding: " + encoding;
+
+            auto compression = TileDecoder::parseCompression(layer.value("compression", std::string{}));
+            if (!compression.has_value())
+                return compression.error();
+
+            for (auto& chunk : layer["chunks"])
             {
-                level.addChunk(layerIndex,
-                               {chunk["x"].get<int>(),
-                                chunk["y"].get<int>(),
-                                chunk["width"].get<int>(),
-                                chunk["height"].get<int>(),
-                                chunk["data"].get<std::vector<u32>>()});
+                Level::Chunk parsed{chunk["x"].get<int>(),
+                                    chunk["y"].get<int>(),
+                                    chunk["width"].get<int>(),
+                                    chunk["height"].get<int>(),
+                                    {}};
+                auto tileCount = static_cast<std::size_t>(parsed.width) * static_cast<std::size_t>(parsed.height);
+
+                if (encoding == "base64")
+                {
+                    // Decoded on first access, until then the chunk only keeps the string taken from the JSON
+                    auto text = std::move(chunk["data"].get_ref<std::string&>());
+                    if (*compression == TileDecoder::Compression::None &&
+                        TileDecoder::decodedSize(text) != tileCount * sizeof(u32))
+                        return std::format("Chunk at {}, {}: data does not match the chunk size", parsed.x, parsed.y);
+
+                    parsed.tiles = std::make_shared<ChunkTiles>(
+                        tileCount,
+                        [text = std::move(text), compression = *compression, x = parsed.x, y = parsed.y](
+                            std::span<u32> tiles) -> std::optional<std::string>
+                        {
+                            // Compressed chunk bytes, reused across chunks decoded on the same thread
+                            thread_local std::vector<u8> scratch;
+                            if (auto error = TileDecoder::decode(text, compression, tiles, scratch); error.has_value())
+                                return std::format("Chunk at {}, {}: {}", x, y, *error);
+                            return {};
+                        });
+                }
+                else
+                {
+                    auto tiles = chunk["data"].get<std::vector<u32>>();
+                    if (tiles.size() != tileCount)
+                        return std::format("Chunk at {}, {}: data does not match the chunk size", parsed.x, parsed.y);
+                    parsed.tiles = std::make_shared<ChunkTiles>(std::move(tiles));
+                }
+
+                level.addChunk(layerIndex, std::move(parsed));
             }
         }
         else if (type == "objectgroup")
@@ -82,6 +124,12 @@ std::optional<std::string> parseLayers(Level& level, nlohmann::json& levelFile)
                                     return "Polyline property duration needs to be float";
                                 animation.duration = prop["value"].get<float>();
                             }
+                            else if (prop["name"] == "phase")
+                            {
+                                if (prop["type"] != "float")
+                                    return "Polyline property phase needs to be float";
+                                animation.phase = prop["value"].get<float>();
+                            }
                             else if (prop["name"] == "angularVelocity")
                             {
                                 if (prop["type"] != "float")
@@ -152,11 +200,39 @@ std::optional<std::string> parseTilesets(Level& level, nlohmann::json& levelFile
         if (!imageLoadResult.has_value())
             return std::format("Could not read tile image: {}", imagePath.c_str());
 
+        level.addSourceFile(tilesetPath);
+        level.addSourceFile(imagePath);
+
+        // Tiles with properties or animations are listed under tiles, only the animations are used
+        std::vector<Level::TileAnimation> animations;
+        for (const auto& tile : tilesetDesc.value("tiles", nlohmann::json::array()))
+        {
+            if (!tile.contains("animation") || tile["animation"].empty())
+                continue;
+
+            auto& animation = animations.emplace_back(tile["id"].get<u32>());
+            for (const auto& frame : tile["animation"])
+                animation.frames.push_back({frame["tileid"].get<u32>(), frame["duration"].get<u32>()});
+        }
+
+        // The atlas reads tiles by column, an image narrower than the columns would be read past its rows
+        auto columns = tilesetDesc["columns"].get<unsigned>();
+        auto tileWidth = tilesetDesc["tilewidth"].get<unsigned>();
+        if (u64{columns} * tileWidth > imageLoadResult->getSize().x)
+        {
+            return std::format("Tileset {}: {} columns of {} pixels do not fit its {} pixel wide image",
+                               tilesetPath.string(),
+                               columns,
+                               tileWidth,
+                               imageLoadResult->getSize().x);
+        }
+
         level.addTileset(Level::Tileset{
             std::move(*imageLoadResult),
             tileset["firstgid"].get<unsigned>(),
-            {tilesetDesc["tilewidth"].get<unsigned>(), tilesetDesc["tileheight"].get<unsigned>()},
-            tilesetDesc["columns"].get<unsigned>(),
+            {tileWidth, tilesetDesc["tileheight"].get<unsigned>()},
+            columns,
+            std::move(animations),
         });
     }
 
@@ -2,10 +2,16 @@
 
 #include <expected>
 #include <filesystem>
+#include <optional>
 
 #include "level.hpp"
+#include "nlohmann/json_fwd.hpp"
 
 namespace LevelParser
 {
 std::expected<Level, std::string> fromFile(const std::filesystem::path& path);
-}
+
+// Tile and object layers of a parsed level file. Tile layers may use the csv or the base64 encoding, optionally
+// compressed with zlib, gzip or zstd. base64 chunk data is moved out of levelFile and decoded on first access.
+std::optional<std::string> parseLayers(Level& level, nlohmann::json& levelFile);
+} // namespace LevelParser
@@ -2,127 +2,500 @@
 
 #include "level.hpp"
 
-#include <SFML/Graphics/RectangleShape.hpp>
 #include <SFML/Graphics/RenderWindow.hpp>
-#include <iostream>
+#include <SFML/Graphics/Transform.hpp>
+#include <algorithm>
+#include <array>
+#include <format>
+#include <stdexcept>
 
-LevelRenderer::LevelRenderer(const Level& level) : mLevel{level}
+namespace
 {
-    const auto& tilesets = level.getTilesets();
-    for (const auto& tileset : tilesets)
+const u32 flippedHorizontallyFlag = 0x80000000;
+const u32 flippedVerticallyFlag = 0x40000000;
+const u32 flippedDiagonallyFlag = 0x20000000;
+const u32 rotatedHexagonal120Flag = 0x10000000;
+
+constexpr std::size_t tileVertexCount = 6;
+
+// Fills the two triangles of a tile
+void writeTile(std::span<sf::Vertex, tileVertexCount> vertices, sf::Vector2f center, sf::IntRect texRect, u32 flags)
+{
+    if (flags & rotatedHexagonal120Flag)
+    {
+        throw std::runtime_error("Rotated hexagon 120 tile rendering not implemented!");
+    }
+
+    // Corners in drawing order of the two triangles: top left, top right, bottom left, bottom right
+    const std::array<sf::Vector2f, 4> corners = {{{0.f, 0.f}, {1.f, 0.f}, {0.f, 1.f}, {1.f, 1.f}}};
+    std::array<sf::Vertex, 4> quad;
+
+    for (std::size_t i = 0; i < corners.size(); i++)
+    {
+        // Tiled applies the diagonal flip first, followed by the horizontal and vertical flips. Undo them in
+        // reverse order to find the texture corner that ends up at this position.
+        sf::Vector2f tex = corners[i];
+        if (flags & flippedHorizontallyFlag)
+            tex.x = 1.f - tex.x;
+        if (flags & flippedVerticallyFlag)
+            tex.y = 1.f - tex.y;
+        if (flags & flippedDiagonallyFlag)
+            std::swap(tex.x, tex.y);
+
+        quad[i].position = center - sf::Vector2f{0.5f, 0.5f} + corners[i];
+        quad[i].color = sf::Color::White;
+        quad[i].texCoords = sf::Vector2f(texRect.position) + sf::Vector2f{tex.x * static_cast<float>(texRect.size.x),
+                                                                          tex.y * static_cast<float>(texRect.size.y)};
+    }
+
+    vertices[0] = quad[0];
+    vertices[1] = quad[1];
+    vertices[2] = quad[2];
+    vertices[3] = quad[2];
+    vertices[4] = quad[1];
+    vertices[5] = quad[3];
+}
+
+void appendTile(std::vector<sf::Vertex>& vertices, sf::Vector2f center, sf::IntRect texRect, u32 flags)
+{
+    vertices.resize(vertices.size() + tileVertexCount);
+    writeTile(std::span(vertices).last<tileVertexCount>(), center, texRect, flags);
+}
+
+sf::FloatRect rectBounds(sf::Vector2f position, sf::Vector2f size)
+{
+    // Conservative bounds covering every rotation of the rect
+    size /= 32.f;
+    sf::Vector2f center = (position / 32.f) - sf::Vector2f{0.5f, 0.5f} + (size * 0.5f);
+    float radius = size.length() * 0.5f;
+    return {center - sf::Vector2f{radius, radius}, {2.f * radius, 2.f * radius}};
+}
+} // namespace
+
+LevelRenderer::LevelRenderer(const Level& level, float streamMargin) :
+    mLevel{level},
+    mTiles{level.getTileLayers()},
+    mTileGeneration{level.generation()},
+    mStreamMargin{streamMargin}
+{
+    loadAtlas();
+    indexChunks();
+    indexRects();
+}
+
+void LevelRenderer::reload(const Level::Changes& changes)
+{
+    // Level::reload dropped all edits, the level's tiles are authoritative again. Copying the chunks only copies
+    // references to their tiles.
+    mTiles = mLevel.getTileLayers();
+    mTileGeneration = mLevel.generation();
+
+    // Resident batches hold texture coordinates and animation indices of the current atlas, so all of them are
+    // dropped before the atlas is replaced. Tiles of the other tilesets move as well when one of them changes size.
+    bool atlasChanged = !changes.tilesets.empty() || changes.tilesetLayout;
+    if (changes.chunkLayout || atlasChanged)
+    {
+        for (std::size_t residentIndex = mResidentChunks.size(); residentIndex-- > 0;)
+            unloadChunk(mResidentChunks[residentIndex]);
+        indexChunks();
+    }
+    else
+    {
+        // Chunk refs are in layer order, so the index of a chunk is its offset in the layers before it
+        const auto& tileLayers = mTiles;
+        for (auto [layer, chunk] : changes.chunks)
+        {
+            u32 chunkIndex = chunk;
+            for (u32 previous = 0; previous < layer; previous++)
+                chunkIndex += static_cast<u32>(tileLayers[previous].size());
+
+            if (mChunkResident[chunkIndex] != 0)
+                unloadChunk(chunkIndex);
+        }
+    }
+
+    if (atlasChanged)
+        loadAtlas();
+
+    if (changes.rectLayout || changes.rebuiltRects > 0)
+        indexRects();
+}
+
+void LevelRenderer::applyTileChanges(std::span<const TileChange> changes, u64 generation)
+{
+    if (generation != mTileGeneration)
+        return;
+
+    u64 applied = mAppliedTileTick;
+    for (const auto& [tick, edit] : changes)
+    {
+        if (tick <= applied)
+            continue;
+
+        mVisible.clear();
+        mChunkGrid.query({{static_cast<float>(edit.x) - 0.5f, static_cast<float>(edit.y) - 0.5f}, {1.f, 1.f}},
+                         mVisible);
+        for (u32 chunkIndex : mVisible)
+        {
+            const auto& [layer, index] = mChunkRefs[chunkIndex];
+            auto& chunk = mTiles[layer][index];
+            if (layer != edit.layer || edit.x < chunk.x || edit.y < chunk.y || edit.x >= chunk.x + chunk.width ||
+                edit.y >= chunk.y + chunk.height)
+                continue;
+
+            ChunkTiles::makeUnique(chunk.tiles);
+            chunk.tiles->get()[(edit.x - chunk.x) + ((edit.y - chunk.y) * chunk.width)] = edit.gid;
+            // Rebuilt by the next render if still in range
+            if (mChunkResident[chunkIndex] != 0)
+                unloadChunk(chunkIndex);
+            break;
+        }
+
+        mAppliedTileTick = tick;
+    }
+}
+
+void LevelRenderer::loadAtlas()
+{
+    mAtlas = TileAtlas(mLevel.getTilesets());
+
+    auto size = mAtlas.image().getSize();
+    if (std::max(size.x, size.y) > sf::Texture::getMaximumSize())
+    {
+        throw std::runtime_error(std::format("Tile atlas of {}x{} pixels exceeds the maximum texture size of {}",
+                                             size.x,
+                                             size.y,
+                                             sf::Texture::getMaximumSize()));
+    }
+
+    mAnimationFrames.assign(mAtlas.animations().size(), 0);
+    mAnimationChanged.assign(mAtlas.animations().size(), 0);
+
+    mAtlasTexture = *sf::Texture::loadFromImage(mAtlas.image());
+    // No mip maps, each level halves the extrusion and tiles would bleed into their neighbours again from the
+    // second level on
+    mAtlasTexture.setSmooth(false);
+    mAtlasTexture.setRepeated(false);
+}
+
+void LevelRenderer::indexChunks()
+{
+    mChunkGrid.clear();
+    mChunkRefs.clear();
+    mChunkGeometry.clear();
+    mChunkResident.clear();
+    mResidentChunks.clear();
+
+    const auto& tileLayers = mTiles;
+    for (std::size_t layerIndex = 0; layerIndex < tileLayers.size(); layerIndex++)
     {
-        auto tex = mTilesetTextures.emplace_back(*sf::Texture::loadFromImage(tileset.image));
-        tex.setSmooth(false);
-        tex.setRepeated(false);
-        if (!tex.generateMipmap())
+        for (std::size_t chunkIndex = 0; chunkIndex < tileLayers[layerIndex].size(); chunkIndex++)
         {
-            std::cout << "Could not generate mip maps for tilesets" << std::endl;
+            const auto& chunk = tileLayers[layerIndex][chunkIndex];
+            mChunkGrid.insert(static_cast<u32>(mChunkRefs.size()),
+                              {{static_cast<float>(chunk.x) - 0.5f, static_cast<float>(chunk.y) - 0.5f},
+                               {static_cast<float>(chunk.width), static_cast<float>(chunk.height)}});
+            mChunkRefs.push_back({layerIndex, chunkIndex});
         }
     }
+    mChunkGeometry.resize(mChunkRefs.size());
+    mChunkResident.resize(mChunkRefs.size());
+}
+
+void LevelRenderer::indexRects()
+{
+    mStaticRectGrid.clear();
+    mRectRefs.clear();
+    mAnimatedRects.clear();
 
-    for (const auto& layer : level.getTileLayers())
+    const auto& rectLayers = mLevel.getRectLayers();
+    for (std::size_t layerIndex = 0; layerIndex < rectLayers.size(); layerIndex++)
     {
-        for (const auto& chunk : layer)
+        for (std::size_t rectIndex = 0; rectIndex < rectLayers[layerIndex].size(); rectIndex++)
         {
-            for (int x = 0; x < chunk.width; x++)
+            const auto& rect = rectLayers[layerIndex][rectIndex].value;
+            auto item = static_cast<u32>(mRectRefs.size());
+            auto& ref = mRectRefs.emplace_back(layerIndex, rectIndex);
+
+            // Level::registerCollision animates exactly these rects, in the same order
+            if (rect.animationIndex.has_value())
+            {
+                ref.animatedIndex = static_cast<u32>(mAnimatedRects.size());
+                mAnimatedRects.push_back(item);
+            }
+            else
             {
-                for (int y = 0; y < chunk.height; y++)
-                {
-                    int linearIndex = x + (y * chunk.width);
-
-                    if (chunk.data[linearIndex] != 0)
-                    {
-                        sf::Vector2f pos{static_cast<float>(chunk.x + x) - 0.5f, static_cast<float>(chunk.y + y) - 0.5f};
-                        sf::Vector2f size{1.f, 1.f};
-                        sf::RectangleShape shape(size);
-                        shape.setPosition(pos);
-                        shape.setFillColor(sf::Color::White);
-
-                        const unsigned flippedHorizontallyFlag = 0x80000000;
-                        const unsigned flippedVerticallyFlag = 0x40000000;
-                        const unsigned flippedDiagonallyFlag = 0x20000000;
-                        const unsigned rotatedHexagonal120Flag = 0x10000000;
-
-                        u32 rawTileData = chunk.data[linearIndex];
-
-                        u32 globalTileId = rawTileData & (~(flippedHorizontallyFlag | flippedVerticallyFlag |
-                                                            flippedDiagonallyFlag | rotatedHexagonal120Flag));
-
-                        std::size_t tilesetIndex = 0;
-                        while ((tilesetIndex + 1) < tilesets.size() && tilesets[tilesetIndex + 1].firstGid < globalTileId)
-                        {
-                            tilesetIndex++;
-                        }
-
-                        const auto& tileset = tilesets[tilesetIndex];
-
-                        u32 localTileId = globalTileId - tileset.firstGid;
-                        u32 col = localTileId % tileset.columns;
-                        u32 row = localTileId / tileset.columns;
-
-                        sf::IntRect texRect{{static_cast<int>(col * tileset.tileDim.x),
-                                             static_cast<int>(row * tileset.tileDim.y)},
-                                            static_cast<sf::Vector2i>(tileset.tileDim)};
-
-                        // Move origin to center to allow for easier tile rotations
-                        shape.setOrigin(shape.getSize() * 0.5f);
-                        shape.move(shape.getSize() * 0.5f);
-                        if (rawTileData & flippedDiagonallyFlag)
-                        {
-                            shape.rotate(sf::degrees(90.f));
-                            shape.scale({-1.f, 1.f});
-                        }
-                        if (rawTileData & flippedHorizontallyFlag)
-                        {
-                            shape.scale({-1.f, 1.f});
-                        }
-                        if (rawTileData & flippedVerticallyFlag)
-                        {
-                            shape.scale({1.f, -1.f});
-                        }
-                        if (rawTileData & rotatedHexagonal120Flag)
-                        {
-                            throw std::runtime_error("Rotated hexagon 120 tile rendering not implemented!");
-                        }
-
-                        shape.setTexture(&mTilesetTextures[tilesetIndex]);
-                        shape.setTextureRect(texRect);
-                        mRects.push_back(shape);
-                    }
-                }
+                mStaticRectGrid.insert(item, rectBounds(rect.position, rect.size));
             }
         }
     }
 }
 
-void LevelRenderer::render(sf::RenderWindow& window)
+void LevelRenderer::render(sf::RenderWindow& window, std::span<const RectSnapshot> animatedRects, float alpha)
+{
+    const auto& view = window.getView();
+    sf::FloatRect viewBounds{view.getCenter() - (view.getSize() * 0.5f), view.getSize()};
+
+    animateTiles();
+    streamChunks(viewBounds);
+    drawTiles(window, viewBounds);
+    drawRects(window, viewBounds, animatedRects, alpha);
+}
+
+void LevelRenderer::streamChunks(sf::FloatRect viewBounds)
+{
+    auto grow = [&](float margin)
+    {
+        return sf::FloatRect{viewBounds.position - sf::Vector2f{margin, margin},
+                             viewBounds.size + sf::Vector2f{2.f * margin, 2.f * margin}};
+    };
+
+    sf::FloatRect keepArea = grow(2.f * mStreamMargin);
+    const auto& tileLayers = mTiles;
+    for (std::size_t residentIndex = mResidentChunks.size(); residentIndex-- > 0;)
+    {
+        u32 chunkIndex = mResidentChunks[residentIndex];
+        const auto& [layer, index] = mChunkRefs[chunkIndex];
+        const auto& chunk = tileLayers[layer][index];
+        sf::FloatRect bounds{{static_cast<float>(chunk.x) - 0.5f, static_cast<float>(chunk.y) - 0.5f},
+                             {static_cast<float>(chunk.width), static_cast<float>(chunk.height)}};
+
+        if (bounds.findIntersection(keepArea).has_value())
+            continue;
+
+        unloadChunk(chunkIndex);
+    }
+
+    mVisible.clear();
+    mChunkGrid.query(grow(mStreamMargin), mVisible);
+    for (u32 chunkIndex : mVisible)
+    {
+        if (mChunkResident[chunkIndex] != 0)
+            continue;
+
+        buildChunk(chunkIndex);
+        mChunkResident[chunkIndex] = 1;
+        mResidentChunks.push_back(chunkIndex);
+    }
+
+    mCullingStats.residentChunks = mResidentChunks.size();
+}
+
+void LevelRenderer::unloadChunk(u32 chunkIndex)
 {
-    drawTiles(window);
-    drawRects(window);
+    mChunkGeometry[chunkIndex] = {};
+    mChunkResident[chunkIndex] = 0;
+
+    auto resident = std::ranges::find(mResidentChunks, chunkIndex);
+    *resident = mResidentChunks.back();
+    mResidentChunks.pop_back();
 }
 
-void LevelRenderer::drawTiles(sf::RenderWindow& window)
+void LevelRenderer::buildChunk(u32 chunkIndex)
 {
-    for (const auto& rect : mRects)
+    const auto& [layer, index] = mChunkRefs[chunkIndex];
+    const auto& chunk = mTiles[layer][index];
+    auto tiles = chunk.data();
+
+    for (int y = 0; y < chunk.height; y++)
+    {
+        for (int x = 0; x < chunk.width; x++)
+        {
+            u32 rawTileData = tiles[x + (y * chunk.width)];
+
+            if (rawTileData == 0)
+                continue;
+
+            u32 globalTileId = rawTileData & (~(flippedHorizontallyFlag | flippedVerticallyFlag |
+                                                flippedDiagonallyFlag | rotatedHexagonal120Flag));
+
+            // Ids no tileset covers stay empty
+            sf::IntRect texRect = mAtlas.rect(globalTileId);
+            if (texRect.size.x == 0)
+                continue;
+
+            sf::Vector2f center{static_cast<float>(chunk.x + x), static_cast<float>(chunk.y + y)};
+            if (auto animation = mAtlas.animation(globalTileId); animation.has_value())
+            {
+                mAnimatedTiles.push_back({*animation, rawTileData, center});
+                continue;
+            }
+
+            appendTile(mTileVertices, center, texRect, rawTileData);
+        }
+    }
+
+    auto& geometry = mChunkGeometry[chunkIndex];
+    geometry = {};
+
+    if (!mTileVertices.empty())
+    {
+        auto& vertices = geometry.tiles.emplace(sf::PrimitiveType::Triangles, sf::VertexBuffer::Usage::Static);
+        if (!vertices.create(mTileVertices.size()) || !vertices.update(mTileVertices.data()))
+        {
+            throw std::runtime_error("Could not create vertex buffer for tile chunk");
+        }
+
+        mTileVertices.clear();
+    }
+
+    if (mAnimatedTiles.empty())
+        return;
+
+    std::ranges::stable_sort(mAnimatedTiles, {}, &AnimatedTile::animation);
+    const auto& animations = mAtlas.animations();
+    for (u32 tile = 0; tile < mAnimatedTiles.size(); tile++)
     {
-        window.draw(rect);
+        const auto& animated = mAnimatedTiles[tile];
+        if (geometry.animatedRuns.empty() || geometry.animatedRuns.back().animation != animated.animation)
+            geometry.animatedRuns.push_back({animated.animation, tile, 0});
+        geometry.animatedRuns.back().tileCount++;
+
+        appendTile(geometry.animatedVertices,
+                   animated.center,
+                   animations[animated.animation].frames[mAnimationFrames[animated.animation]],
+                   animated.flags);
+    }
+    geometry.animated.assign(mAnimatedTiles.begin(), mAnimatedTiles.end());
+    mAnimatedTiles.clear();
+
+    // Rewritten whenever one of the animations advances
+    auto& vertices = geometry.animatedTiles.emplace(sf::PrimitiveType::Triangles, sf::VertexBuffer::Usage::Dynamic);
+    if (!vertices.create(geometry.animatedVertices.size()) || !vertices.update(geometry.animatedVertices.data()))
+    {
+        throw std::runtime_error("Could not create vertex buffer for animated tiles");
     }
 }
 
-void LevelRenderer::drawRects(sf::RenderWindow& window)
+void LevelRenderer::animateTiles()
 {
-    for (const auto& layer : mLevel.getRectLayers())
+    const auto& animations = mAtlas.animations();
+    if (animations.empty())
+        return;
+
+    auto time = static_cast<u32>(mAnimationClock.getElapsedTime().asMilliseconds());
+    bool changed = false;
+    for (std::size_t index = 0; index < animations.size(); index++)
+    {
+        u32 frame = animations[index].frameAt(time);
+        mAnimationChanged[index] = frame != mAnimationFrames[index] ? 1 : 0;
+        mAnimationFrames[index] = frame;
+        changed = changed || mAnimationChanged[index] != 0;
+    }
+
+    if (!changed)
+        return;
+
+    // Only the runs of animations that changed are rewritten and uploaded, the rest of the buffer keeps its contents
+    for (u32 chunkIndex : mResidentChunks)
     {
-        for (const auto& object : layer)
+        auto& geometry = mChunkGeometry[chunkIndex];
+        for (const auto& run : geometry.animatedRuns)
         {
-            const auto& rect = object.value;
-
-            sf::RectangleShape shape(rect.size / 32.f);
-            shape.setOrigin((rect.size * 0.5f) / 32.f);
-            shape.setPosition((rect.position / 32.f) - sf::Vector2f{0.5f, 0.5f} + shape.getOrigin());
-            shape.setFillColor(sf::Color::Blue);
-            shape.setRotation(rect.rotation);
-            window.draw(shape);
+            if (mAnimationChanged[run.animation] == 0)
+                continue;
+
+            sf::IntRect texRect = animations[run.animation].frames[mAnimationFrames[run.animation]];
+            for (u32 tile = run.firstTile; tile < run.firstTile + run.tileCount; tile++)
+            {
+                const auto& animated = geometry.animated[tile];
+                writeTile(std::span(geometry.animatedVertices).subspan(tile * tileVertexCount).first<tileVertexCount>(),
+                          animated.center,
+                          texRect,
+                          animated.flags);
+            }
+
+            auto first = static_cast<unsigned>(run.firstTile * tileVertexCount);
+            std::size_t count = run.tileCount * tileVertexCount;
+            if (!geometry.animatedTiles->update(geometry.animatedVertices.data() + first, count, first))
+            {
+                throw std::runtime_error("Could not update vertex buffer for animated tiles");
+            }
         }
     }
 }
+
+void LevelRenderer::drawTiles(sf::RenderWindow& window, sf::FloatRect viewBounds)
+{
+    mVisible.clear();
+    mChunkGrid.query(viewBounds, mVisible);
+
+    sf::RenderStates states(&mAtlasTexture);
+    std::size_t drawn = 0;
+    for (u32 chunkIndex : mVisible)
+    {
+        const auto& geometry = mChunkGeometry[chunkIndex];
+        if (geometry.tiles.has_value())
+            window.draw(*geometry.tiles, states);
+        if (geometry.animatedTiles.has_value())
+            window.draw(*geometry.animatedTiles, states);
+
+        drawn += geometry.tiles.has_value() || geometry.animatedTiles.has_value() ? 1 : 0;
+    }
+
+    std::size_t resident = 0;
+    for (u32 chunkIndex : mResidentChunks)
+    {
+        const auto& geometry = mChunkGeometry[chunkIndex];
+        resident += geometry.tiles.has_value() || geometry.animatedTiles.has_value() ? 1 : 0;
+    }
+
+    mCullingStats.drawnTileBatches = drawn;
+    mCullingStats.culledTileBatches = resident - drawn;
+}
+
+void LevelRenderer::drawRects(sf::RenderWindow& window,
+                              sf::FloatRect viewBounds,
+                              std::span<const RectSnapshot> animatedRects,
+                              float alpha)
+{
+    const auto& rectLayers = mLevel.getRectLayers();
+
+    mAnimatedPoses.resize(std::min(mAnimatedRects.size(), animatedRects.size()));
+    for (std::size_t i = 0; i < mAnimatedPoses.size(); i++)
+    {
+        mAnimatedPoses[i] = interpolate(animatedRects[i].previous, animatedRects[i].current, alpha);
+    }
+
+    mVisible.clear();
+    mStaticRectGrid.query(viewBounds, mVisible);
+    for (std::size_t i = 0; i < mAnimatedPoses.size(); i++)
+    {
+        if (rectBounds(mAnimatedPoses[i].position, animatedRects[i].size).findIntersection(viewBounds).has_value())
+            mVisible.push_back(mAnimatedRects[i]);
+    }
+    // Keep the layer order of the level
+    std::ranges::sort(mVisible);
+
+    // One batch for all rects, the vertices keep their capacity across frames
+    mRectVertices.clear();
+    for (u32 item : mVisible)
+    {
+        const auto& ref = mRectRefs[item];
+        const auto& rect = rectLayers[ref.layer][ref.index].value;
+        Pose pose = ref.animatedIndex.has_value() ? mAnimatedPoses[*ref.animatedIndex]
+                                                  : Pose{rect.position, rect.rotation};
+
+        // Rotates around the center like Level::Rect, positions are offset by half a tile like the tiles
+        sf::Vector2f halfSize = (rect.size * 0.5f) / 32.f;
+        sf::Transform transform;
+        transform.translate((pose.position / 32.f) - sf::Vector2f{0.5f, 0.5f} + halfSize);
+        transform.rotate(pose.rotation);
+
+        // Top left, top right, bottom left, bottom right
+        std::array<sf::Vertex, 4> quad;
+        quad[0].position = transform.transformPoint({-halfSize.x, -halfSize.y});
+        quad[1].position = transform.transformPoint({halfSize.x, -halfSize.y});
+        quad[2].position = transform.transformPoint({-halfSize.x, halfSize.y});
+        quad[3].position = transform.transformPoint({halfSize.x, halfSize.y});
+        for (auto& vertex : quad)
+            vertex.color = sf::Color::Blue;
+
+        mRectVertices.insert(mRectVertices.end(), {quad[0], quad[1], quad[2], quad[2], quad[1], quad[3]});
+    }
+    if (!mRectVertices.empty())
+        window.draw(mRectVertices.data(), mRectVertices.size(), sf::PrimitiveType::Triangles);
+
+    mCullingStats.drawnRects = mVisible.size();
+    mCullingStats.culledRects = mRectRefs.size() - mVisible.size();
+}
@@ -1,27 +1,142 @@
 #pragma once
 
-#include <SFML/Graphics/RectangleShape.hpp>
+#include "level.hpp"
+#include "renderSnapshot.hpp"
+#include "spatialGrid.hpp"
+#include "tileAtlas.hpp"
+#include "types.hpp"
+
 #include <SFML/Graphics/Texture.hpp>
+#include <SFML/Graphics/VertexBuffer.hpp>
+#include <SFML/System/Clock.hpp>
+#include <optional>
+#include <span>
+#include <vector>
 
 namespace sf
 {
 class RenderWindow;
 }
 
-class Level;
-
 class LevelRenderer
 {
 public:
-    LevelRenderer(const Level& level);
-    void render(sf::RenderWindow& window);
+    struct CullingStats
+    {
+        std::size_t drawnTileBatches{};
+        std::size_t culledTileBatches{};
+        std::size_t residentChunks{};
+        std::size_t drawnRects{};
+        std::size_t culledRects{};
+    };
+
+    // Tile vertex buffers only exist for chunks within streamMargin meters of the view. They are built when a chunk
+    // comes into range and freed once it is twice as far away.
+    explicit LevelRenderer(const Level& level, float streamMargin = 16.f);
+    // animatedRects holds the poses of every animated rect, see RenderSnapshot::rects. alpha blends between their
+    // previous and current pose.
+    void render(sf::RenderWindow& window, std::span<const RectSnapshot> animatedRects, float alpha);
+
+    // Updates the textures, vertex buffers and culling indices affected by a Level::reload. Call while the level
+    // cannot be modified, e.g. through SimulationThread::access.
+    void reload(const Level::Changes& changes);
+    // Applies the changes newer than the ones applied before to the own copy of the tiles and rebuilds the chunks
+    // they touch, see RenderSnapshot::tileChanges. Changes of another Level::generation than the one of the last
+    // reload are ignored.
+    void applyTileChanges(std::span<const TileChange> changes, u64 generation);
+
+    const CullingStats& cullingStats() const { return mCullingStats; }
 
 private:
-    void drawTiles(sf::RenderWindow& window);
-    void drawRects(sf::RenderWindow& window);
+    struct ChunkRef
+    {
+        std::size_t layer{};
+        std::size_t index{};
+    };
+
+    struct RectRef
+    {
+        std::size_t layer{};
+        std::size_t index{};
+        // Index into the animated rect transforms, if the rect is animated
+        std::optional<u32> animatedIndex;
+    };
+
+    // Tile playing a TileAtlas animation
+    struct AnimatedTile
+    {
+        u32 animation{};
+        u32 flags{};
+        sf::Vector2f center;
+    };
+
+    // Consecutive animated tiles of a chunk playing the same animation
+    struct AnimatedRun
+    {
+        u32 animation{};
+        u32 firstTile{};
+        u32 tileCount{};
+    };
+
+    // Animated tiles live in their own buffer, a frame change then only rewrites their vertices
+    struct ChunkGeometry
+    {
+        std::optional<sf::VertexBuffer> tiles;
+        std::optional<sf::VertexBuffer> animatedTiles;
+        // Sorted by animation, with a copy of the vertices of the animated buffer
+        std::vector<AnimatedTile> animated;
+        std::vector<AnimatedRun> animatedRuns;
+        std::vector<sf::Vertex> animatedVertices;
+    };
+
+    void loadAtlas();
+    void indexChunks();
+    void indexRects();
+    void unloadChunk(u32 chunk);
+    void streamChunks(sf::FloatRect viewBounds);
+    void buildChunk(u32 chunk);
+    // Advances the tile animations and rewrites the vertices of the resident animated tiles whose frame changed
+    void animateTiles();
+    void drawTiles(sf::RenderWindow& window, sf::FloatRect viewBounds);
+    void drawRects(sf::RenderWindow& window,
+                   sf::FloatRect viewBounds,
+                   std::span<const RectSnapshot> animatedRects,
+                   float alpha);
 
     const Level& mLevel;
+    // Chunks as of construction or the last reload plus applyTileChanges. Their tiles are shared with the level,
+    // which copies a chunk's tiles before writing to them, so the renderer never reads tiles another thread writes.
+    std::vector<std::vector<Level::Chunk>> mTiles;
+    u64 mTileGeneration{};
+    u64 mAppliedTileTick{};
+
+    // All tilesets in one texture, so every chunk draws with a single call and without texture switches
+    TileAtlas mAtlas;
+    sf::Texture mAtlasTexture;
+    sf::Clock mAnimationClock;
+    // Current frame of every atlas animation, and whether it changed this frame
+    std::vector<u32> mAnimationFrames;
+    std::vector<u8> mAnimationChanged;
+    float mStreamMargin{};
+
+    // In layer order, so drawing them sorted by index keeps the layers stacked correctly
+    std::vector<ChunkRef> mChunkRefs;
+    // Buffers are empty while the chunk is not resident or has no tiles of the kind
+    std::vector<ChunkGeometry> mChunkGeometry;
+    std::vector<u8> mChunkResident;
+    std::vector<u32> mResidentChunks;
+    std::vector<sf::Vertex> mTileVertices;
+    std::vector<AnimatedTile> mAnimatedTiles;
 
-    std::vector<sf::Texture> mTilesetTextures;
-    std::vector<sf::RectangleShape> mRects;
+    // Culling index keyed by chunk sized cells. Animated rects move every tick and are tested individually.
+    // Static rects are read from the level, which the simulation never modifies.
+    SpatialGrid mChunkGrid{16.f};
+    SpatialGrid mStaticRectGrid{16.f};
+    std::vector<RectRef> mRectRefs;
+    std::vector<u32> mAnimatedRects;
+    std::vector<u32> mVisible;
+    // Interpolated poses of the animated rects for the current frame
+    std::vector<Pose> mAnimatedPoses;
+    std::vector<sf::Vertex> mRectVertices;
+    CullingStats mCullingStats;
 };
@@ -0,0 +1,305 @@
+#include "log.hpp"
+
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <cstdio>
+
+namespace Log
+{
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+const auto epoch = Clock::now();
+
+// How often the writer picks up messages, and how often a repeated message is printed at most
+constexpr auto drainInterval = std::chrono::milliseconds(10);
+constexpr auto repeatInterval = std::chrono::seconds(1);
+
+std::atomic<Severity> minimumSeverity{Severity::Info};
+
+// Single producer, single consumer queue between a thread and the writer
+struct ThreadRing
+{
+    std::array<detail::Message, ringCapacity> messages;
+    // Messages committed by the thread and consumed by the writer
+    std::atomic<u64> head{};
+    std::atomic<u64> tail{};
+    std::atomic<u64> dropped{};
+};
+
+std::string_view severityName(Severity severity)
+{
+    switch (severity)
+    {
+    case Severity::Debug:
+        return "debug";
+    case Severity::Info:
+        return "info";
+    case Severity::Warning:
+        return "warn";
+    case Severity::Error:
+        return "error";
+    }
+    return "?";
+}
+
+class Writer
+{
+public:
+    Writer() : mThread([this](const std::stop_token& stopToken) { run(stopToken); }) {}
+
+    // Writes everything still queued before returning
+    ~Writer()
+    {
+        mThread.request_stop();
+        mThread.join();
+    }
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    ThreadRing& addRing()
+    {
+        std::scoped_lock lock(mRingsMutex);
+        return *mRings.emplace_back(std::make_unique<ThreadRing>());
+    }
+
+    std::optional<std::string> openFile(const std::filesystem::path& path)
+    {
+        std::ofstream file(path, std::ios::app);
+        if (!file)
+            return std::format("Could not open {} for writing", path.string());
+
+        std::scoped_lock lock(mFileMutex);
+        mFile = std::move(file);
+        return {};
+    }
+
+private:
+    struct Repeat
+    {
+        Severity severity{};
+        const char* category{};
+        std::string text;
+        // Repetitions not printed yet
+        u64 count{};
+        Clock::time_point printed;
+    };
+
+    void run(const std::stop_token& stopToken)
+    {
+        LUMIAX_THREAD_NAME("Log writer");
+
+        // Nothing but the stop request wakes the writer early, logging threads never signal it
+        std::condition_variable_any wake;
+        std::mutex wakeMutex;
+        while (true)
+        {
+            // A last pass after the stop request picks up the messages of the final moments
+            bool stopping = stopToken.stop_requested();
+            drain();
+            if (stopping)
+                return;
+
+            std::unique_lock lock(wakeMutex);
+            wake.wait_for(lock, stopToken, drainInterval, [] { return false; });
+        }
+    }
+
+    void drain()
+    {
+        {
+            std::scoped_lock lock(mRingsMutex);
+            mDrained.clear();
+            for (const auto& ring : mRings)
+                mDrained.push_back(ring.get());
+        }
+
+        mPending.clear();
+        for (ThreadRing* ring : mDrained)
+        {
+            u64 tail = ring->tail.load(std::memory_order_relaxed);
+            u64 head = ring->head.load(std::memory_order_acquire);
+            for (; tail < head; tail++)
+                mPending.push_back(ring->messages[tail % ringCapacity]);
+            ring->tail.store(tail, std::memory_order_release);
+
+            if (u64 dropped = ring->dropped.exchange(0, std::memory_order_relaxed); dropped > 0)
+            {
+                detail::Message& message = mPending.emplace_back();
+                auto result = std::format_to_n(
+                    message.text.data(), maxMessageLength, "{} messages dropped, the thread's ring was full", dropped);
+                message.length = static_cast<u32>(std::min(static_cast<std::size_t>(result.size), maxMessageLength));
+                message.time = head > 0 ? ring->messages[(head - 1) % ringCapacity].time : 0;
+                message.category = "Log";
+                message.severity = Severity::Warning;
+            }
+        }
+
+        // Rings are drained one after the other, restore the order across threads
+        std::ranges::stable_sort(mPending, {}, &detail::Message::time);
+
+        for (const auto& message : mPending)
+            print(message);
+
+        // Repetitions are summarized once the interval passed, even when the message stopped repeating
+        if (mRepeat.count > 0 && Clock::now() - mRepeat.printed >= repeatInterval)
+            printRepeats();
+
+        flush();
+    }
+
+    void print(const detail::Message& message)
+    {
+        std::string_view text(message.text.data(), message.length);
+        if (message.severity == mRepeat.severity && message.category == mRepeat.category && text == mRepeat.text)
+        {
+            mRepeat.count++;
+            return;
+        }
+
+        if (mRepeat.count > 0)
+            printRepeats();
+
+        mRepeat.severity = message.severity;
+        mRepeat.category = message.category;
+        mRepeat.text.assign(text);
+        mRepeat.printed = Clock::now();
+
+        mLine.clear();
+        std::format_to(std::back_inserter(mLine),
+                       "[{:9.3f}] {:<5} {}: {}\n",
+                       static_cast<double>(message.time) / 1e9,
+                       severityName(message.severity),
+                       message.category,
+                       text);
+        output(message.severity);
+    }
+
+    void printRepeats()
+    {
+        mLine.clear();
+        std::format_to(std::back_inserter(mLine),
+                       "{:11} {:<5} {}: last message repeated {} times\n",
+                       "",
+                       severityName(mRepeat.severity),
+                       mRepeat.category,
+                       mRepeat.count);
+        output(mRepeat.severity);
+
+        mRepeat.count = 0;
+        mRepeat.printed = Clock::now();
+    }
+
+    void output(Severity severity)
+    {
+        std::fwrite(mLine.data(), 1, mLine.size(), severity >= Severity::Warning ? stderr : stdout);
+
+        std::scoped_lock lock(mFileMutex);
+        if (mFile.is_open())
+            mFile << mLine;
+    }
+
+    void flush()
+    {
+        std::fflush(stdout);
+
+        std::scoped_lock lock(mFileMutex);
+        if (mFile.is_open())
+            mFile.flush();
+    }
+
+    std::mutex mRingsMutex;
+    // Never shrinks, rings of finished threads are still drained
+    std::vector<std::unique_ptr<ThreadRing>> mRings;
+
+    std::mutex mFileMutex;
+    std::ofstream mFile;
+
+    // Only touched by the writer thread
+    std::vector<ThreadRing*> mDrained;
+    std::vector<detail::Message> mPending;
+    Repeat mRepeat;
+    std::string mLine;
+
+    std::jthread mThread;
+};
+
+Writer& writer()
+{
+    static Writer instance;
+    return instance;
+}
+
+ThreadRing& threadRing()
+{
+    thread_local ThreadRing* ring = &writer().addRing();
+    return *ring;
+}
+} // namespace
+
+void setMinimumSeverity(Severity severity)
+{
+    minimumSeverity.store(severity, std::memory_order_relaxed);
+}
+
+std::optional<Severity> parseSeverity(std::string_view name)
+{
+    for (auto severity : {Severity::Debug, Severity::Info, Severity::Warning, Severity::Error})
+    {
+        if (name == severityName(severity))
+            return severity;
+    }
+    // Printed as warn to line up with the other names
+    if (name == "warning")
+        return Severity::Warning;
+    return std::nullopt;
+}
+
+std::optional<std::string> openFile(const std::filesystem::path& path)
+{
+    return writer().openFile(path);
+}
+
+namespace detail
+{
+bool enabled(Severity severity)
+{
+    return severity >= minimumSeverity.load(std::memory_order_relaxed);
+}
+
+Message* beginMessage()
+{
+    auto& ring = threadRing();
+    u64 head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) == ringCapacity)
+    {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    auto& message = ring.messages[head % ringCapacity];
+    message.time = static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count());
+    return &message;
+}
+
+void commitMessage()
+{
+    auto& ring = threadRing();
+    ring.head.store(ring.head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+} // namespace detail
+} // namespace Log
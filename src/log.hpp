@@ -0,0 +1,100 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <format>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Logging that never waits for the terminal. Messages are formatted straight into a lock-free ring buffer of the
+// calling thread and written to the console and the log file by a background thread. Messages that find the ring
+// full are dropped and counted, identical messages repeated in a row are printed at most once per second.
+// Categories must be string literals, don't log from static destructors.
+namespace Log
+{
+enum class Severity : u8
+{
+    Debug,
+    Info,
+    Warning,
+    Error
+};
+
+// Longer messages are truncated
+constexpr std::size_t maxMessageLength = 232;
+// Messages per thread waiting to be written
+constexpr std::size_t ringCapacity = 512;
+
+// Messages below severity are discarded before they are formatted, Info by default
+void setMinimumSeverity(Severity severity);
+// Severity named debug, info, warning or error, for command line options
+std::optional<Severity> parseSeverity(std::string_view name);
+
+// Additionally writes all messages to path, replacing a previously opened file
+std::optional<std::string> openFile(const std::filesystem::path& path);
+
+namespace detail
+{
+struct Message
+{
+    // Nanoseconds since the first message
+    u64 time{};
+    const char* category{};
+    u32 length{};
+    Severity severity{};
+    std::array<char, maxMessageLength> text;
+};
+
+bool enabled(Severity severity);
+// Slot for the next message of the calling thread, nullptr if its ring is full
+Message* beginMessage();
+// Hands the message returned by beginMessage over to the logging thread
+void commitMessage();
+} // namespace detail
+
+template <typename... Args>
+void write(Severity severity, const char* category, std::format_string<Args...> format, Args&&... args)
+{
+    if (!detail::enabled(severity))
+        return;
+
+    detail::Message* message = detail::beginMessage();
+    if (message == nullptr)
+        return;
+
+    auto result = std::format_to_n(message->text.data(), maxMessageLength, format, std::forward<Args>(args)...);
+    message->length = static_cast<u32>(std::min(static_cast<std::size_t>(result.size), maxMessageLength));
+    message->category = category;
+    message->severity = severity;
+    detail::commitMessage();
+}
+
+template <typename... Args>
+void debug(const char* category, std::format_string<Args...> format, Args&&... args)
+{
+    write(Severity::Debug, category, format, std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+void info(const char* category, std::format_string<Args...> format, Args&&... args)
+{
+    write(Severity::Info, category, format, std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+void warning(const char* category, std::format_string<Args...> format, Args&&... args)
+{
+    write(Severity::Warning, category, format, std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+void error(const char* category, std::format_string<Args...> format, Args&&... args)
+{
+    write(Severity::Error, category, format, std::forward<Args>(args)...);
+}
+} // namespace Log
@@ -9,29 +9,113 @@ extern "C"
 }
 // NOLINTEND
 
-#include "box2d/b2_fixture.h"
-#include "box2d/b2_polygon_shape.h"
+#include "allocationTracker.hpp"
 #include "box2d/b2_body.h"
-#include "box2d/b2_world.h"
 #include "debugRenderer.hpp"
+#include "fileWatcher.hpp"
+#include "gameClient.hpp"
 #include "imgui-SFML.h"
 #include "imgui.h"
+#include "levelBinary.hpp"
 #include "levelParser.hpp"
 #include "levelRenderer.hpp"
+#include "log.hpp"
+#include "profiler.hpp"
+#include "profilerPanel.hpp"
+#include "replay.hpp"
 #include "ship.hpp"
 #include "shipRenderer.hpp"
+#include "simulation.hpp"
+#include "simulationThread.hpp"
 
 #include <SFML/Graphics/RenderWindow.hpp>
 #include <SFML/Window/Joystick.hpp>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <format>
 #include <iostream>
 #include <print>
 #include <ranges>
+#include <span>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include <cmath>
 
-int main()
+int main(int argc, char** argv)
 {
+    std::span args(argv, static_cast<std::size_t>(argc));
+
+    // --record <file> stores the session's input for playback with lumiax_bench --replay <file>
+    // --connect <host>[:<port>] plays on a lumiax_server instead of simulating locally
+    // --log <file> additionally appends the log to file, --log-level <severity> sets the minimum severity
+    std::optional<std::filesystem::path> recordPath;
+    std::optional<sf::IpAddress> serverAddress;
+    u16 serverPort = NetProtocol::defaultPort;
+    std::optional<std::filesystem::path> logPath;
+
+    bool validArgs = args.size() % 2 == 1;
+    for (std::size_t i = 1; validArgs && i + 1 < args.size(); i += 2)
+    {
+        std::string_view name(args[i]);
+        std::string_view value(args[i + 1]);
+
+        if (name == "--record")
+        {
+            recordPath = value;
+        }
+        else if (name == "--connect")
+        {
+            std::string_view address = value;
+            bool validPort = true;
+            if (auto separator = address.rfind(':'); separator != std::string_view::npos)
+            {
+                auto portText = address.substr(separator + 1);
+                auto [ptr, ec] = std::from_chars(portText.data(), portText.data() + portText.size(), serverPort);
+                validPort = ec == std::errc{} && ptr == portText.data() + portText.size();
+                address = address.substr(0, separator);
+            }
+            if (validPort)
+                serverAddress = sf::IpAddress::resolve(address);
+            validArgs = serverAddress.has_value();
+        }
+        else if (name == "--log")
+        {
+            logPath = value;
+        }
+        else if (name == "--log-level")
+        {
+            auto severity = Log::parseSeverity(value);
+            validArgs = severity.has_value();
+            if (validArgs)
+                Log::setMinimumSeverity(*severity);
+        }
+        else
+        {
+            validArgs = false;
+        }
+    }
+
+    if (!validArgs || (recordPath.has_value() && serverAddress.has_value()))
+    {
+        std::println(std::cerr,
+                     "Usage: {} [--record <file> | --connect <host>[:<port>]] [--log <file>] "
+                     "[--log-level <debug|info|warning|error>]",
+                     args[0]);
+        return 1;
+    }
+
+    if (logPath.has_value())
+    {
+        if (auto error = Log::openFile(*logPath); error.has_value())
+        {
+            std::println(std::cerr, "{}", *error);
+            return 1;
+        }
+    }
+
     sf::RenderWindow window(sf::VideoMode{{1280, 720}},
                             "Lumiax",
                             sf::State::Windowed,
@@ -40,7 +124,7 @@ int main()
 
     if (!ImGui::SFML::Init(window))
     {
-        std::print(std::cerr, "Could not setup ImGui for SFML");
+        Log::error("ImGui", "Could not setup ImGui for SFML");
     }
 
     sf::Clock gameClock;
@@ -50,91 +134,204 @@ int main()
     debugRenderer.AppendFlags(b2Draw::e_shapeBit);
     debugRenderer.AppendFlags(b2Draw::e_centerOfMassBit);
 
-    b2World world({0.f, 0.f});
-    world.SetDebugDraw(&debugRenderer);
-
-
-    std::vector ships = {createTriangleShip(world, sf::Color::Green, {1.f, 1.4f}, {5.f, 10.f}),
-                         createTriangleShip(world, sf::Color::Red, {1.f, 1.5f}, {5.f, 5.f})};
-
     sf::Time fixedUpdateRate = sf::seconds(1.f / 60.f);
-    sf::Time accumulatedTime{};
-    sf::Time gameTime{};
 
     bool enableDebugDraw{false};
 
-    auto levelResult = LevelParser::fromFile("../../data/levels/level01.json");
+    // Prefer the output of lumiax_level_compiler unless it is from another version or any level, tileset or image
+    // file was edited after compiling
+    std::filesystem::path levelPath = "../../data/levels/level01.json";
+    auto compiledLevelPath = std::filesystem::path(levelPath).replace_extension(".lvl");
+    std::expected<Level, std::string> levelResult = std::unexpected(std::string{});
+    if (LevelBinary::isCurrent(compiledLevelPath))
+    {
+        levelResult = LevelBinary::fromFile(compiledLevelPath);
+        if (!levelResult.has_value())
+            Log::warning("Level", "Falling back to {}: {}", levelPath.string(), levelResult.error());
+    }
+    if (!levelResult.has_value())
+        levelResult = LevelParser::fromFile(levelPath);
     if (!levelResult.has_value())
     {
-        std::cout << "Failed to load level: " << levelResult.error();
+        Log::error("Level", "Failed to load level: {}", levelResult.error());
         return 1;
     }
+
+    // Clients render the level they loaded, everything moving comes from the server
     Level& level = levelResult.value();
+    std::optional<GameClient> client;
+    if (serverAddress.has_value())
+    {
+        auto connection = GameClient::connect(*serverAddress, serverPort);
+        if (!connection.has_value())
+        {
+            Log::error("Network", "{}", connection.error());
+            return 1;
+        }
+        client.emplace(std::move(connection.value()));
+    }
+
+    std::optional<Simulation> simulation;
+    std::optional<Replay::Recorder> recorder;
+    std::optional<SimulationThread> simulationThread;
+
+    TickInput input;
+    input.ships.resize(2);
+
+    if (!client.has_value())
+    {
+        simulation.emplace(std::move(level), fixedUpdateRate);
+        simulation->world().SetDebugDraw(&debugRenderer);
+
+        simulation->addShip(sf::Color::Green, {1.f, 1.4f}, {5.f, 10.f});
+        simulation->addShip(sf::Color::Red, {1.f, 1.5f}, {5.f, 5.f});
+
+        if (recordPath.has_value())
+            recorder.emplace(*simulation, levelPath.string());
+
+        // From here on the simulation is owned by its thread, rendering only reads the published snapshots
+        simulationThread.emplace(*simulation,
+                                 [&recorder](const TickInput& tickInput, const Simulation& tickSimulation)
+                                 {
+                                     if (recorder.has_value())
+                                         recorder->record(tickInput, tickSimulation);
+                                 });
+    }
+
+    LevelRenderer levelRenderer(simulation.has_value() ? simulation->level() : level);
+
+    // Edits are always picked up from the source level, even if the compiled one was loaded
+    FileWatcher levelWatcher;
+    levelWatcher.watch(levelPath);
+    for (const auto& file : (simulation.has_value() ? simulation->level() : level).sourceFiles())
+        levelWatcher.watch(file);
 
-    level.registerCollision(world);
-    LevelRenderer levelRenderer(level);
+    LUMIAX_THREAD_NAME("Main");
+    ProfilerPanel profilerPanel;
+
+    // Allocations of the main thread during the previous frame
+    AllocationTracker::Counts frameAllocations;
+    auto frameAllocationsStart = AllocationTracker::thread();
+    bool joystickConnected = false;
 
     while (window.isOpen())
     {
+        LUMIAX_ZONE("Frame");
         auto deltaTime = gameClock.restart();
 
-        while (std::optional<sf::Event> event = window.pollEvent())
-        {
-            ImGui::SFML::ProcessEvent(window, *event);
+        auto allocations = AllocationTracker::thread();
+        frameAllocations = allocations - frameAllocationsStart;
+        frameAllocationsStart = allocations;
 
-            if (event->is<sf::Event::Closed>())
+        if (levelWatcher.poll())
+        {
+            LUMIAX_ZONE("Level reload");
+            auto reloadStart = std::chrono::steady_clock::now();
+            auto fresh = LevelParser::fromFile(levelPath);
+            if (!fresh.has_value())
             {
-                window.close();
+                // Usually a save in progress, the next write triggers another attempt
+                Log::warning("Level", "Could not reload level: {}", fresh.error());
             }
-            else if (const auto* keyEvent = event->getIf<sf::Event::KeyPressed>(); keyEvent != nullptr)
+            else
             {
-                if (keyEvent->code == sf::Keyboard::Key::Escape)
+                for (const auto& file : fresh->sourceFiles())
+                    levelWatcher.watch(file);
+
+                Level::Changes changes;
+                if (simulationThread.has_value())
                 {
-                    window.close();
+                    simulationThread->access(
+                        [&](Simulation& sim)
+                        {
+                            changes = sim.reloadLevel(std::move(*fresh));
+                            levelRenderer.reload(changes);
+                        });
+                }
+                else
+                {
+                    changes = level.reload(std::move(*fresh));
+                    levelRenderer.reload(changes);
                 }
+
+                std::chrono::duration<double, std::milli> reloadTime = std::chrono::steady_clock::now() - reloadStart;
+                Log::info("Level",
+                          "Reloaded level in {:.1f} ms: {} chunks, {} collision regions, {} tilesets, {} rects{}",
+                          reloadTime.count(),
+                          changes.chunkLayout ? "all" : std::to_string(changes.chunks.size()),
+                          changes.rebuiltRegions,
+                          changes.tilesets.size(),
+                          changes.rectLayout ? "all" : std::to_string(changes.rebuiltRects),
+                          changes.empty() ? " (no changes)" : "");
             }
         }
 
-        accumulatedTime += deltaTime;
-
-        while (accumulatedTime >= fixedUpdateRate)
         {
-            gameTime += deltaTime;
-
-            ships[0].thruster(Ship::Direction::Up, sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Up));
-            ships[0].thruster(Ship::Direction::Down, sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Down));
-            ships[0].thruster(Ship::Direction::Left, sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Left));
-            ships[0].thruster(Ship::Direction::Right, sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Right));
-
-            ships[1].thruster(Ship::Direction::Up, sf::Keyboard::isKeyPressed(sf::Keyboard::Key::W));
-            ships[1].thruster(Ship::Direction::Down, sf::Keyboard::isKeyPressed(sf::Keyboard::Key::S));
-            ships[1].thruster(Ship::Direction::Left, sf::Keyboard::isKeyPressed(sf::Keyboard::Key::A));
-            ships[1].thruster(Ship::Direction::Right, sf::Keyboard::isKeyPressed(sf::Keyboard::Key::D));
-
-            std::cout << "Joystick connected: " << sf::Joystick::isConnected(0) << std::endl;
-
-            float deadzone = 20.f;
+            LUMIAX_ZONE("Input");
+            while (std::optional<sf::Event> event = window.pollEvent())
+            {
+                ImGui::SFML::ProcessEvent(window, *event);
 
-            ships[1].thruster(Ship::Direction::Up,
-                              sf::Joystick::getAxisPosition(0, sf::Joystick::Axis::R) > (-100.f + deadzone));
-            ships[1].thruster(Ship::Direction::Down,
-                              sf::Joystick::getAxisPosition(0, sf::Joystick::Axis::Z) > (-100.f + deadzone));
-            ships[1].thruster(Ship::Direction::Right, sf::Joystick::getAxisPosition(0, sf::Joystick::Axis::X) > deadzone);
-            ships[1].thruster(Ship::Direction::Left, sf::Joystick::getAxisPosition(0, sf::Joystick::Axis::X) < -deadzone);
+                if (event->is<sf::Event::Closed>())
+                {
+                    window.close();
+                }
+                else if (const auto* keyEvent = event->getIf<sf::Event::KeyPressed>(); keyEvent != nullptr)
+                {
+                    if (keyEvent->code == sf::Keyboard::Key::Escape)
+                    {
+                        window.close();
+                    }
+                }
+            }
 
-            for (auto& ship : ships)
-                ship.update();
+            // Sampled once per frame, the simulation thread applies the latest state on its next tick
+            input.ships[0].set(Ship::Direction::Up, sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Up));
+            input.ships[0].set(Ship::Direction::Down, sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Down));
+            input.ships[0].set(Ship::Direction::Left, sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Left));
+            input.ships[0].set(Ship::Direction::Right, sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Right));
 
-            accumulatedTime -= fixedUpdateRate;
+            input.ships[1].set(Ship::Direction::Up, sf::Keyboard::isKeyPressed(sf::Keyboard::Key::W));
+            input.ships[1].set(Ship::Direction::Down, sf::Keyboard::isKeyPressed(sf::Keyboard::Key::S));
+            input.ships[1].set(Ship::Direction::Left, sf::Keyboard::isKeyPressed(sf::Keyboard::Key::A));
+            input.ships[1].set(Ship::Direction::Right, sf::Keyboard::isKeyPressed(sf::Keyboard::Key::D));
 
-            int32 velocityIterations = 8;
-            int32 positionIterations = 3;
+            if (bool connected = sf::Joystick::isConnected(0); connected != joystickConnected)
+            {
+                Log::info("Input", "Joystick {}", connected ? "connected" : "disconnected");
+                joystickConnected = connected;
+            }
 
-            level.updateAnimations(gameTime);
+            float deadzone = 20.f;
 
-            world.Step(fixedUpdateRate.asSeconds(), velocityIterations, positionIterations);
+            input.ships[1].set(Ship::Direction::Up,
+                               sf::Joystick::getAxisPosition(0, sf::Joystick::Axis::R) > (-100.f + deadzone));
+            input.ships[1].set(Ship::Direction::Down,
+                               sf::Joystick::getAxisPosition(0, sf::Joystick::Axis::Z) > (-100.f + deadzone));
+            input.ships[1].set(Ship::Direction::Right,
+                               sf::Joystick::getAxisPosition(0, sf::Joystick::Axis::X) > deadzone);
+            input.ships[1].set(Ship::Direction::Left,
+                               sf::Joystick::getAxisPosition(0, sf::Joystick::Axis::X) < -deadzone);
         }
 
+        const RenderSnapshot* snapshot = nullptr;
+        float alpha = 1.f;
+        if (client.has_value())
+        {
+            // The keyboard arrows and first joystick both steer the own ship
+            client->input(static_cast<u8>(input.ships[0].thrusters | input.ships[1].thrusters));
+            client->receive();
+            snapshot = &client->snapshot();
+            alpha = client->interpolationAlpha();
+        }
+        else
+        {
+            simulationThread->input(input);
+            snapshot = &simulationThread->snapshot();
+            alpha = simulationThread->interpolationAlpha(*snapshot);
+            levelRenderer.applyTileChanges(snapshot->tileChanges, snapshot->tileGeneration);
+            simulationThread->acknowledgeTileChanges(snapshot->tick);
+        }
 
         ImGui::SFML::Update(window, deltaTime);
 
@@ -145,36 +342,83 @@ int main()
 
         float cameraWidth = 40.f;
         sf::Vector2f viewDim = sf::Vector2f(cameraWidth, cameraWidth * aspect);
-        sf::Vector2f viewPosition = viewDim * 0.5f -
-                                    (ships[0].position() + ships[0].centerOfMass().rotatedBy(ships[0].rotation()));
+        sf::Vector2f viewPosition = viewDim * 0.5f - snapshot->cameraTarget(alpha);
 
         sf::View view(sf::FloatRect(-viewPosition, viewDim));
         window.setView(view);
 
         ImGui::Begin("Debug");
 
-        for (auto [index, ship] : ships | std::ranges::views::enumerate)
+        for (auto [index, ship] : snapshot->ships | std::ranges::views::enumerate)
         {
-            if (ImGui::CollapsingHeader(("Ship_" + std::to_string(index)).c_str()))
+            // Formatted into a fixed buffer, the header is submitted every frame
+            std::array<char, 32> label{};
+            std::format_to_n(label.data(), label.size() - 1, "Ship_{}", index);
+            if (ImGui::CollapsingHeader(label.data()))
             {
-                sf::Vector2f shipPos = ship.position();
-                if (ImGui::SliderFloat2("Ship Position", &shipPos.x, 1.f, 1000.f))
+                sf::Vector2f shipPos = ship.current.position;
+                // Both go through the recorded input, so replays of the session reproduce them
+                auto shipIndex = static_cast<u32>(index);
+                if (ImGui::SliderFloat2("Ship Position", &shipPos.x, 1.f, 1000.f) && simulationThread.has_value())
+                {
+                    simulationThread->command(
+                        {.type = SimulationCommand::Type::MoveShip, .ship = shipIndex, .position = shipPos});
+                }
+                if (ImGui::Button("Blast walls") && simulationThread.has_value())
                 {
-                    ship.position(shipPos);
+                    simulationThread->command(
+                        {.type = SimulationCommand::Type::BlastTiles, .ship = shipIndex, .radius = 2});
                 }
-                b2Vec2 airResistance = ship.airResistance();
+                b2Vec2 airResistance = ship.airResistance;
                 ImGui::InputFloat2("Air resistance:", &airResistance.x);
-                b2Vec2 linearAcceleration = ship.linearAccerleration();
+                b2Vec2 linearAcceleration = ship.linearAcceleration;
                 ImGui::InputFloat2("Linear acceleration:", &linearAcceleration.x);
-                float a = ship.rotation().asDegrees();
+                float a = ship.current.rotation.asDegrees();
                 ImGui::InputFloat("Rotation (deg):", &a);
-                float v = ship.body().GetLinearVelocity().Length();
+                float v = ship.speed;
                 ImGui::InputFloat("Velocity :", &v);
             }
         }
 
         ImGui::Checkbox("Enable debug rendering", &enableDebugDraw);
 
+        if (enableDebugDraw && ImGui::CollapsingHeader("Debug rendering"))
+        {
+            for (auto [name, flag] : {std::pair{"Shapes", b2Draw::e_shapeBit},
+                                      std::pair{"Joints", b2Draw::e_jointBit},
+                                      std::pair{"AABBs", b2Draw::e_aabbBit},
+                                      std::pair{"Pairs", b2Draw::e_pairBit},
+                                      std::pair{"Center of mass", b2Draw::e_centerOfMassBit}})
+            {
+                bool enabled = (debugRenderer.GetFlags() & flag) != 0;
+                if (ImGui::Checkbox(name, &enabled))
+                {
+                    if (enabled)
+                        debugRenderer.AppendFlags(flag);
+                    else
+                        debugRenderer.ClearFlags(flag);
+                }
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Culling"))
+        {
+            const auto& culling = levelRenderer.cullingStats();
+            ImGui::Text("Tile batches drawn: %zu culled: %zu", culling.drawnTileBatches, culling.culledTileBatches);
+            ImGui::Text("Resident chunks: %zu", culling.residentChunks);
+            ImGui::Text("Rects drawn: %zu culled: %zu", culling.drawnRects, culling.culledRects);
+        }
+
+        if (ImGui::CollapsingHeader("Allocations"))
+        {
+            ImGui::Text("Frame: %zu allocations, %zu bytes", frameAllocations.allocations, frameAllocations.bytes);
+            if (simulationThread.has_value())
+            {
+                const auto& tick = snapshot->tickAllocations;
+                ImGui::Text("Simulation tick: %zu allocations, %zu bytes", tick.allocations, tick.bytes);
+            }
+        }
+
         if (ImGui::CollapsingHeader("Joystick"))
         {
             for (int joystickIndex = 0; joystickIndex < 4; joystickIndex++)
@@ -227,22 +471,49 @@ int main()
         }
 
         ImGui::End();
-        ImGui::SFML::Render(window);
+
+        profilerPanel.draw();
+
+        {
+            LUMIAX_ZONE("ImGui::SFML::Render");
+            ImGui::SFML::Render(window);
+        }
 
         shipRenderer.reset();
-        for (const auto& ship : ships)
+        for (const auto& ship : snapshot->ships)
         {
-            shipRenderer.drawShip(ship);
+            shipRenderer.drawShip(ship, alpha);
         }
 
-        levelRenderer.render(window);
+        {
+            LUMIAX_ZONE("LevelRenderer::render");
+            levelRenderer.render(window, snapshot->rects, alpha);
+        }
         window.draw(shipRenderer.vertexArray());
 
-        if (enableDebugDraw)
-            world.DebugDraw();
+        // Draws the live world, which may be a tick ahead of the snapshot
+        if (enableDebugDraw && simulationThread.has_value())
+        {
+            debugRenderer.begin();
+            simulationThread->access([](Simulation& sim) { sim.world().DebugDraw(); });
+            debugRenderer.flush();
+        }
 
+        LUMIAX_ZONE("Display");
         window.display();
     }
 
     ImGui::SFML::Shutdown();
+
+    if (simulationThread.has_value())
+        simulationThread->stop();
+
+    if (recorder.has_value())
+    {
+        if (auto error = Replay::toFile(recorder->recording(), *recordPath); error.has_value())
+        {
+            Log::error("Replay", "Could not save recording: {}", *error);
+            return 1;
+        }
+    }
 }
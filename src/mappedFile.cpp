@@ -0,0 +1,127 @@
+#include "mappedFile.hpp"
+
+#include <format>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::expected<MappedFile, std::string> MappedFile::open(const std::filesystem::path& path)
+{
+    MappedFile file;
+
+#ifdef _WIN32
+    HANDLE fileHandle = CreateFileW(path.c_str(),
+                                    GENERIC_READ,
+                                    FILE_SHARE_READ,
+                                    nullptr,
+                                    OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL,
+                                    nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return std::unexpected(std::format("Could not open file: {}", path.string()));
+    file.mFileHandle = fileHandle;
+
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(fileHandle, &size))
+        return std::unexpected(std::format("Could not query file size: {}", path.string()));
+    file.mSize = static_cast<std::size_t>(size.QuadPart);
+
+    if (file.mSize == 0)
+        return file;
+
+    HANDLE mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle == nullptr)
+        return std::unexpected(std::format("Could not map file: {}", path.string()));
+    file.mMappingHandle = mappingHandle;
+
+    void* data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr)
+        return std::unexpected(std::format("Could not map file: {}", path.string()));
+    file.mData = static_cast<const std::byte*>(data);
+#else
+    file.mFd = ::open(path.c_str(), O_RDONLY);
+    if (file.mFd < 0)
+        return std::unexpected(std::format("Could not open file: {}", path.string()));
+
+    struct stat status{};
+    if (fstat(file.mFd, &status) != 0)
+        return std::unexpected(std::format("Could not query file size: {}", path.string()));
+    file.mSize = static_cast<std::size_t>(status.st_size);
+
+    if (file.mSize == 0)
+        return file;
+
+    void* data = mmap(nullptr, file.mSize, PROT_READ, MAP_PRIVATE, file.mFd, 0);
+    if (data == MAP_FAILED)
+        return std::unexpected(std::format("Could not map file: {}", path.string()));
+    file.mData = static_cast<const std::byte*>(data);
+#endif
+
+    return file;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+    mData{std::exchange(other.mData, nullptr)},
+    mSize{std::exchange(other.mSize, 0)},
+#ifdef _WIN32
+    mFileHandle{std::exchange(other.mFileHandle, nullptr)},
+    mMappingHandle{std::exchange(other.mMappingHandle, nullptr)}
+#else
+    mFd{std::exchange(other.mFd, -1)}
+#endif
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        mData = std::exchange(other.mData, nullptr);
+        mSize = std::exchange(other.mSize, 0);
+#ifdef _WIN32
+        mFileHandle = std::exchange(other.mFileHandle, nullptr);
+        mMappingHandle = std::exchange(other.mMappingHandle, nullptr);
+#else
+        mFd = std::exchange(other.mFd, -1);
+#endif
+    }
+
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (mData != nullptr)
+        UnmapViewOfFile(mData);
+    if (mMappingHandle != nullptr)
+        CloseHandle(mMappingHandle);
+    if (mFileHandle != nullptr)
+        CloseHandle(mFileHandle);
+    mMappingHandle = nullptr;
+    mFileHandle = nullptr;
+#else
+    if (mData != nullptr)
+        munmap(const_cast<std::byte*>(mData), mSize);
+    if (mFd >= 0)
+        ::close(mFd);
+    mFd = -1;
+#endif
+    mData = nullptr;
+    mSize = 0;
+}
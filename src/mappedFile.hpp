@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <expected>
+#include <filesystem>
+#include <span>
+#include <string>
+
+// Read only memory mapping of a whole file
+class MappedFile
+{
+public:
+    static std::expected<MappedFile, std::string> open(const std::filesystem::path& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    ~MappedFile();
+
+    std::span<const std::byte> bytes() const { return {mData, mSize}; }
+
+private:
+    MappedFile() = default;
+
+    void close();
+
+    const std::byte* mData{};
+    std::size_t mSize{};
+#ifdef _WIN32
+    void* mFileHandle{};
+    void* mMappingHandle{};
+#else
+    int mFd{-1};
+#endif
+};
@@ -0,0 +1,37 @@
+#include "matchRunner.hpp"
+
+MatchRunner::MatchRunner(Level prototype,
+                         std::size_t matchCount,
+                         const std::vector<ShipSpawn>& ships,
+                         sf::Time fixedStep,
+                         unsigned threadCount) :
+    mPool{threadCount},
+    mInputs(matchCount),
+    mLatencies(matchCount)
+{
+    // Bake once, every instance then shares the outlines
+    prototype.bakeCollision();
+
+    for (std::size_t index = 0; index < matchCount; index++)
+    {
+        auto& match = mMatches.emplace_back(std::make_unique<Simulation>(prototype.instance(), fixedStep));
+        for (const auto& ship : ships)
+            match->addShip(ship.color, ship.size, ship.position, ship.angle);
+
+        mInputs[index].ships.resize(ships.size());
+    }
+
+    mStepTask = [this](std::size_t index)
+    {
+        auto start = std::chrono::steady_clock::now();
+        mMatches[index]->step(mInputs[index]);
+        mLatencies[index] = std::chrono::steady_clock::now() - start;
+    };
+}
+
+std::chrono::nanoseconds MatchRunner::tick()
+{
+    auto start = std::chrono::steady_clock::now();
+    mPool.parallelFor(mMatches.size(), mStepTask);
+    return std::chrono::steady_clock::now() - start;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "simulation.hpp"
+#include "threadPool.hpp"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+// Independent matches on the same level, stepped in parallel. Every match owns its b2World, ships and animated
+// rects, while tiles, tilesets and baked tile collision are shared through Level::instance.
+class MatchRunner
+{
+public:
+    MatchRunner(Level prototype,
+                std::size_t matchCount,
+                const std::vector<ShipSpawn>& ships,
+                sf::Time fixedStep,
+                unsigned threadCount);
+
+    std::size_t matchCount() const { return mMatches.size(); }
+    unsigned threadCount() const { return mPool.threadCount(); }
+
+    Simulation& match(std::size_t index) { return *mMatches[index]; }
+    // Input applied to the match on the next tick
+    TickInput& input(std::size_t index) { return mInputs[index]; }
+
+    // Steps every match once and returns the wall time for all of them
+    std::chrono::nanoseconds tick();
+
+    // Duration of each match's last step
+    const std::vector<std::chrono::nanoseconds>& latencies() const { return mLatencies; }
+
+private:
+    ThreadPool mPool;
+    std::vector<std::unique_ptr<Simulation>> mMatches;
+    std::vector<TickInput> mInputs;
+    std::vector<std::chrono::nanoseconds> mLatencies;
+    std::function<void(std::size_t)> mStepTask;
+};
@@ -0,0 +1,104 @@
+#include "moverSystem.hpp"
+
+#include "box2d/b2_body.h"
+
+#include <cmath>
+
+u32 MoverSystem::add(std::span<const sf::Vector2f> points,
+                     float duration,
+                     float phase,
+                     float angularVelocity,
+                     sf::Vector2f bodyOffset,
+                     b2Body* body)
+{
+    auto mover = static_cast<u32>(mBodies.size());
+
+    mFirstPoint.push_back(static_cast<u32>(mPointX.size()));
+    mPointCount.push_back(static_cast<u32>(points.size()));
+
+    float length = 0.f;
+    for (std::size_t i = 0; i < points.size(); i++)
+    {
+        if (i > 0)
+            length += (points[i] - points[i - 1]).length();
+
+        mPointX.push_back(points[i].x);
+        mPointY.push_back(points[i].y);
+        mCumulativeLength.push_back(length);
+    }
+
+    mInvDuration.push_back(duration > 0.f ? 1.f / duration : 0.f);
+    mPhase.push_back(phase);
+    mTotalLength.push_back(length);
+    mAngularVelocity.push_back(angularVelocity);
+    mOffsetX.push_back(bodyOffset.x);
+    mOffsetY.push_back(bodyOffset.y);
+    mBodies.push_back(body);
+
+    resize(mBodies.size());
+
+    return mover;
+}
+
+void MoverSystem::resize(std::size_t count)
+{
+    mDistance.resize(count);
+    mPathX.resize(count);
+    mPathY.resize(count);
+    mBodyX.resize(count);
+    mBodyY.resize(count);
+    mBodyAngle.resize(count);
+    mVelocityX.resize(count);
+    mVelocityY.resize(count);
+}
+
+void MoverSystem::update(float time, float tickRate)
+{
+    const std::size_t count = mBodies.size();
+
+    // Travelled distance along the path, a triangle wave going there and back once per duration
+    for (std::size_t i = 0; i < count; i++)
+    {
+        float cycle = (time * mInvDuration[i]) + mPhase[i];
+        float fraction = cycle - std::floor(cycle);
+        mDistance[i] = (1.f - std::abs((2.f * fraction) - 1.f)) * mTotalLength[i];
+    }
+
+    // Segment lookup through the cumulative lengths, paths are short so a linear scan is the fastest option
+    for (std::size_t i = 0; i < count; i++)
+    {
+        u32 first = mFirstPoint[i];
+        u32 last = first + mPointCount[i] - 1;
+
+        u32 segment = first;
+        while (segment + 1 < last && mCumulativeLength[segment + 1] <= mDistance[i])
+            segment++;
+
+        float segmentLength = mCumulativeLength[segment + 1] - mCumulativeLength[segment];
+        float t = segmentLength > 0.f ? (mDistance[i] - mCumulativeLength[segment]) / segmentLength : 0.f;
+
+        mPathX[i] = std::lerp(mPointX[segment], mPointX[segment + 1], t);
+        mPathY[i] = std::lerp(mPointY[segment], mPointY[segment + 1], t);
+    }
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const auto& position = mBodies[i]->GetPosition();
+        mBodyX[i] = position.x;
+        mBodyY[i] = position.y;
+        mBodyAngle[i] = mBodies[i]->GetAngle();
+    }
+
+    // Velocity that moves each body onto its path position within one tick
+    for (std::size_t i = 0; i < count; i++)
+    {
+        mVelocityX[i] = ((mPathX[i] / 32.f) + mOffsetX[i] - mBodyX[i]) * tickRate;
+        mVelocityY[i] = ((mPathY[i] / 32.f) + mOffsetY[i] - mBodyY[i]) * tickRate;
+    }
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        mBodies[i]->SetLinearVelocity({mVelocityX[i], mVelocityY[i]});
+        mBodies[i]->SetAngularVelocity(mAngularVelocity[i]);
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <SFML/System/Vector2.hpp>
+#include <span>
+#include <vector>
+
+class b2Body;
+
+// Kinematic bodies moving back and forth along polylines. State is stored as structure of arrays so the path
+// evaluation runs as plain loops over floats for all movers at once.
+class MoverSystem
+{
+public:
+    // points are in level pixels, bodyOffset is added to the path position (in meters) to get the body position
+    u32 add(std::span<const sf::Vector2f> points,
+            float duration,
+            float phase,
+            float angularVelocity,
+            sf::Vector2f bodyOffset,
+            b2Body* body);
+
+    void update(float time, float tickRate);
+
+    std::size_t size() const { return mBodies.size(); }
+
+    sf::Vector2f pathPosition(u32 mover) const { return {mPathX[mover], mPathY[mover]}; }
+    float bodyAngle(u32 mover) const { return mBodyAngle[mover]; }
+    float angularVelocity(u32 mover) const { return mAngularVelocity[mover]; }
+
+private:
+    void resize(std::size_t count);
+
+    // Per mover parameters
+    std::vector<float> mInvDuration;
+    std::vector<float> mPhase;
+    std::vector<float> mTotalLength;
+    std::vector<float> mAngularVelocity;
+    std::vector<float> mOffsetX;
+    std::vector<float> mOffsetY;
+    std::vector<u32> mFirstPoint;
+    std::vector<u32> mPointCount;
+    std::vector<b2Body*> mBodies;
+
+    // Per mover state, rewritten every update
+    std::vector<float> mDistance;
+    std::vector<float> mPathX;
+    std::vector<float> mPathY;
+    std::vector<float> mBodyX;
+    std::vector<float> mBodyY;
+    std::vector<float> mBodyAngle;
+    std::vector<float> mVelocityX;
+    std::vector<float> mVelocityY;
+
+    // Polyline points of all movers, mCumulativeLength[i] is the path length up to point i of its polyline
+    std::vector<float> mPointX;
+    std::vector<float> mPointY;
+    std::vector<float> mCumulativeLength;
+};
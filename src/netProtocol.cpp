@@ -0,0 +1,246 @@
+#include "netProtocol.hpp"
+
+#include "simulation.hpp"
+
+#include <bit>
+
+#include <cmath>
+
+namespace NetProtocol
+{
+namespace
+{
+i32 quantizeValue(float value, float scale)
+{
+    return static_cast<i32>(std::lround(value * scale));
+}
+
+float dequantizeValue(i32 value, float scale)
+{
+    return static_cast<float>(value) / scale;
+}
+
+// Maps small negative and positive deltas to small unsigned values
+u64 zigzag(i32 value)
+{
+    return static_cast<u64>((static_cast<u32>(value) << 1) ^ static_cast<u32>(value >> 31));
+}
+
+i32 unzigzag(u64 value)
+{
+    auto bits = static_cast<u32>(value);
+    return static_cast<i32>((bits >> 1) ^ (~(bits & 1) + 1));
+}
+
+Pose toPose(const Entity& entity, float positionScale)
+{
+    return {{dequantizeValue(entity.fields[PositionX], positionScale),
+             dequantizeValue(entity.fields[PositionY], positionScale)},
+            sf::radians(dequantizeValue(entity.fields[Angle], angleScale))};
+}
+} // namespace
+
+void PacketWriter::writeVarint(u64 value)
+{
+    while (value >= 0x80)
+    {
+        mBuffer.push_back(static_cast<u8>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    mBuffer.push_back(static_cast<u8>(value));
+}
+
+void PacketWriter::writeHeader(MessageType type)
+{
+    for (int byte = 0; byte < 4; byte++)
+        write(static_cast<u8>(magic >> (byte * 8)));
+    write(version);
+    write(static_cast<u8>(type));
+}
+
+bool PacketReader::read(u8& value)
+{
+    if (mOffset >= mData.size())
+        return false;
+    value = mData[mOffset++];
+    return true;
+}
+
+bool PacketReader::readVarint(u64& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        u8 byte{};
+        if (!read(byte))
+            return false;
+        value |= static_cast<u64>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+std::optional<MessageType> PacketReader::readHeader()
+{
+    u32 packetMagic = 0;
+    for (int byte = 0; byte < 4; byte++)
+    {
+        u8 value{};
+        if (!read(value))
+            return std::nullopt;
+        packetMagic |= static_cast<u32>(value) << (byte * 8);
+    }
+
+    u8 packetVersion{};
+    u8 type{};
+    if (packetMagic != magic || !read(packetVersion) || packetVersion != version || !read(type) ||
+        type > static_cast<u8>(MessageType::Snapshot))
+        return std::nullopt;
+
+    return static_cast<MessageType>(type);
+}
+
+void quantize(const Simulation& simulation, State& state)
+{
+    const auto& ships = simulation.ships();
+    const auto& spawns = simulation.shipSpawns();
+    const auto& level = simulation.level();
+    const auto& rectLayers = level.getRectLayers();
+    const auto& animatedRects = level.animatedRects();
+
+    state.tick = static_cast<u32>(simulation.tick());
+    state.shipCount = static_cast<u32>(ships.size());
+    state.entities.resize(ships.size() + animatedRects.size());
+
+    for (std::size_t i = 0; i < ships.size(); i++)
+    {
+        auto& fields = state.entities[i].fields;
+        fields[PositionX] = quantizeValue(ships[i].position().x, shipPositionScale);
+        fields[PositionY] = quantizeValue(ships[i].position().y, shipPositionScale);
+        fields[Angle] = quantizeValue(ships[i].rotation().asRadians(), angleScale);
+        fields[Color] = std::bit_cast<i32>(ships[i].color().toInteger());
+        fields[SizeX] = quantizeValue(spawns[i].size.x, shipPositionScale);
+        fields[SizeY] = quantizeValue(spawns[i].size.y, shipPositionScale);
+    }
+
+    for (std::size_t i = 0; i < animatedRects.size(); i++)
+    {
+        const auto& rect = rectLayers[animatedRects[i].layer][animatedRects[i].rect].value;
+        auto& fields = state.entities[ships.size() + i].fields;
+        fields[PositionX] = quantizeValue(rect.position.x, rectPositionScale);
+        fields[PositionY] = quantizeValue(rect.position.y, rectPositionScale);
+        fields[Angle] = quantizeValue(rect.rotation.asRadians(), angleScale);
+        fields[Color] = 0;
+        fields[SizeX] = quantizeValue(rect.size.x, rectPositionScale);
+        fields[SizeY] = quantizeValue(rect.size.y, rectPositionScale);
+    }
+}
+
+void dequantize(const State& previous, const State& current, RenderSnapshot& snapshot)
+{
+    snapshot.tick = current.tick;
+    snapshot.ships.resize(current.shipCount);
+    snapshot.rects.resize(current.entities.size() - current.shipCount);
+
+    for (std::size_t i = 0; i < snapshot.ships.size(); i++)
+    {
+        const auto& entity = current.entities[i];
+        auto& ship = snapshot.ships[i];
+
+        // Same hull as createTriangleShip, its centroid is the center of mass
+        sf::Vector2f halfSize{dequantizeValue(entity.fields[SizeX], shipPositionScale) * 0.5f,
+                              dequantizeValue(entity.fields[SizeY], shipPositionScale) * 0.5f};
+        ship.vertices[0] = {0.f, -halfSize.y};
+        ship.vertices[1] = {halfSize.x, halfSize.y};
+        ship.vertices[2] = {-halfSize.x, halfSize.y};
+        ship.vertexCount = 3;
+        ship.centerOfMass = {0.f, halfSize.y / 3.f};
+        ship.color = sf::Color(std::bit_cast<u32>(entity.fields[Color]));
+
+        ship.current = toPose(entity, shipPositionScale);
+        ship.previous = i < previous.shipCount ? toPose(previous.entities[i], shipPositionScale) : ship.current;
+    }
+
+    std::size_t previousRects = previous.entities.size() - previous.shipCount;
+    for (std::size_t i = 0; i < snapshot.rects.size(); i++)
+    {
+        const auto& entity = current.entities[current.shipCount + i];
+        auto& rect = snapshot.rects[i];
+
+        rect.size = {dequantizeValue(entity.fields[SizeX], rectPositionScale),
+                     dequantizeValue(entity.fields[SizeY], rectPositionScale)};
+        rect.current = toPose(entity, rectPositionScale);
+        rect.previous = i < previousRects ? toPose(previous.entities[previous.shipCount + i], rectPositionScale)
+                                          : rect.current;
+    }
+}
+
+void writeState(PacketWriter& writer, const State& base, const State& current)
+{
+    writer.writeVarint(current.shipCount);
+    writer.writeVarint(current.entities.size());
+
+    const Entity empty{};
+    for (std::size_t i = 0; i < current.entities.size(); i++)
+    {
+        const auto& entity = current.entities[i];
+        const auto& baseEntity = i < base.entities.size() ? base.entities[i] : empty;
+
+        u8 mask = 0;
+        for (u8 field = 0; field < FieldCount; field++)
+        {
+            if (entity.fields[field] != baseEntity.fields[field])
+                mask |= static_cast<u8>(1u << field);
+        }
+
+        writer.write(mask);
+        for (u8 field = 0; field < FieldCount; field++)
+        {
+            if ((mask & (1u << field)) == 0)
+                continue;
+
+            // Wrapping difference, decoded with the matching wrapping sum
+            auto delta = static_cast<i32>(static_cast<u32>(entity.fields[field]) -
+                                          static_cast<u32>(baseEntity.fields[field]));
+            writer.writeVarint(zigzag(delta));
+        }
+    }
+}
+
+bool readState(PacketReader& reader, const State& base, State& state)
+{
+    u64 shipCount{};
+    u64 entityCount{};
+    // Every entity takes at least its mask byte
+    if (!reader.readVarint(shipCount) || !reader.readVarint(entityCount) || entityCount > reader.remaining() ||
+        shipCount > entityCount)
+        return false;
+
+    state.shipCount = static_cast<u32>(shipCount);
+    state.entities.resize(entityCount);
+
+    const Entity empty{};
+    for (std::size_t i = 0; i < state.entities.size(); i++)
+    {
+        const auto& baseEntity = i < base.entities.size() ? base.entities[i] : empty;
+        auto& entity = state.entities[i];
+
+        u8 mask{};
+        if (!reader.read(mask))
+            return false;
+
+        for (u8 field = 0; field < FieldCount; field++)
+        {
+            u64 delta = 0;
+            if ((mask & (1u << field)) != 0 && !reader.readVarint(delta))
+                return false;
+
+            entity.fields[field] =
+                static_cast<i32>(static_cast<u32>(baseEntity.fields[field]) + static_cast<u32>(unzigzag(delta)));
+        }
+    }
+
+    return true;
+}
+} // namespace NetProtocol
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "renderSnapshot.hpp"
+#include "types.hpp"
+
+#include <array>
+#include <optional>
+#include <span>
+#include <vector>
+
+class Simulation;
+
+// Wire format shared by GameServer and GameClient. Every datagram starts with magic, version and message type.
+// World states are quantized to integers and sent as deltas against a state the receiver acknowledged, so entities
+// that did not move cost a single byte.
+namespace NetProtocol
+{
+constexpr u32 magic = 0x4e584d4c; // "LMXN"
+constexpr u8 version = 1;
+constexpr u16 defaultPort = 47000;
+
+// States kept by both sides to delta against, older acknowledgements fall back to full states
+constexpr u32 historySize = 64;
+
+enum class MessageType : u8
+{
+    // Client -> server: join request, repeated until welcomed
+    Hello,
+    // Server -> client: varint ship index, varint tick duration in microseconds
+    Welcome,
+    // Client -> server: varint acknowledged tick (0 for none), u8 thrusters
+    Input,
+    // Server -> client: varint tick, varint base tick (0 for a full state), varint ship count, varint entity count,
+    // then per entity a change mask followed by zigzag varint deltas of the changed fields
+    Snapshot,
+};
+
+// Quantized fields of an entity. Ship positions and sizes are in meters, rect ones in level pixels, angles are in
+// radians. Box2D does not wrap angles, so they are not wrapped here either.
+enum Field : u8
+{
+    PositionX,
+    PositionY,
+    Angle,
+    Color,
+    SizeX,
+    SizeY,
+    FieldCount
+};
+
+constexpr float shipPositionScale = 256.f;
+constexpr float rectPositionScale = 8.f;
+constexpr float angleScale = 4096.f;
+
+struct Entity
+{
+    std::array<i32, FieldCount> fields{};
+
+    bool operator==(const Entity&) const = default;
+};
+
+struct State
+{
+    u32 tick{};
+    u32 shipCount{};
+    // Ships followed by the animated rects in Level::animatedRects order
+    std::vector<Entity> entities;
+};
+
+class PacketWriter
+{
+public:
+    explicit PacketWriter(std::vector<u8>& buffer) : mBuffer{buffer} {}
+
+    void write(u8 value) { mBuffer.push_back(value); }
+    void writeVarint(u64 value);
+    void writeHeader(MessageType type);
+
+private:
+    std::vector<u8>& mBuffer;
+};
+
+class PacketReader
+{
+public:
+    explicit PacketReader(std::span<const u8> data) : mData{data} {}
+
+    bool read(u8& value);
+    bool readVarint(u64& value);
+    // Checks magic and version
+    std::optional<MessageType> readHeader();
+
+    std::size_t remaining() const { return mData.size() - mOffset; }
+
+private:
+    std::span<const u8> mData;
+    std::size_t mOffset{};
+};
+
+// Overwrites state with the quantized state of simulation, reusing its storage
+void quantize(const Simulation& simulation, State& state);
+
+// Builds a render snapshot blending from previous to current, previous may be missing entities of current
+void dequantize(const State& previous, const State& current, RenderSnapshot& snapshot);
+
+// Appends the entities of current as delta against base, pass an empty base for a full state. Ticks are not written,
+// they are part of the Snapshot message header.
+void writeState(PacketWriter& writer, const State& base, const State& current);
+// Reads entities written by writeState against the same base, leaving state.tick untouched
+bool readState(PacketReader& reader, const State& base, State& state);
+} // namespace NetProtocol
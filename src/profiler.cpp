@@ -0,0 +1,202 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace Profiler
+{
+namespace
+{
+const auto epoch = std::chrono::steady_clock::now();
+
+// Fields are atomic because readers may copy a slot while its thread overwrites it. Such copies are detected
+// afterwards and dropped, see copyEvents.
+struct Slot
+{
+    std::atomic<const char*> name{};
+    std::atomic<u64> start{};
+    std::atomic<u64> end{};
+    std::atomic<u32> depth{};
+};
+
+// Only written by its own thread
+struct ThreadBuffer
+{
+    std::array<Slot, ringCapacity> slots;
+    std::atomic<u64> written{};
+    // Guarded by Registry::mutex
+    std::string name;
+};
+
+struct Registry
+{
+    std::mutex mutex;
+    // Never shrinks, the events of finished threads stay readable
+    std::vector<std::unique_ptr<ThreadBuffer>> threads;
+};
+
+Registry& registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+thread_local u32 zoneDepth = 0;
+
+ThreadBuffer& threadBuffer()
+{
+    thread_local ThreadBuffer* buffer = []
+    {
+        auto& threads = registry();
+        std::scoped_lock lock(threads.mutex);
+        auto& created = threads.threads.emplace_back(std::make_unique<ThreadBuffer>());
+        created->name = std::format("Thread {}", threads.threads.size());
+        return created.get();
+    }();
+
+    return *buffer;
+}
+
+void record(const char* name, u64 start, u64 end, u32 depth)
+{
+    auto& buffer = threadBuffer();
+    u64 index = buffer.written.load(std::memory_order_relaxed);
+
+    // Pairs with the acquire fence in copyEvents: a reader that sees any of the stores below also sees written at
+    // index or later, and drops the slot as torn. The release store of written alone orders nothing after it.
+    std::atomic_thread_fence(std::memory_order_release);
+    auto& slot = buffer.slots[index % ringCapacity];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+    slot.depth.store(depth, std::memory_order_relaxed);
+
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+void copyEvents(const ThreadBuffer& buffer, u64 since, std::vector<Event>& events)
+{
+    events.clear();
+
+    u64 written = buffer.written.load(std::memory_order_acquire);
+    u64 oldest = written > ringCapacity ? written - ringCapacity : 0;
+
+    // Events are recorded in end order, so walking back from the newest one can stop at the first older than since
+    u64 index = written;
+    while (index > oldest)
+    {
+        const auto& slot = buffer.slots[(index - 1) % ringCapacity];
+        Event event{slot.name.load(std::memory_order_relaxed),
+                    slot.start.load(std::memory_order_relaxed),
+                    slot.end.load(std::memory_order_relaxed),
+                    slot.depth.load(std::memory_order_relaxed)};
+        if (event.end < since)
+            break;
+
+        events.push_back(event);
+        index--;
+    }
+
+    // Slots the writer reached while they were copied may be torn, they hold the oldest copied events. The writer
+    // may also be halfway through the slot following the last published one. The fence pairs with the release
+    // fence in record, so this load sees every index whose slot stores were copied above.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    u64 reached = buffer.written.load(std::memory_order_relaxed) + 1;
+    u64 valid = reached > ringCapacity ? reached - ringCapacity : 0;
+    if (valid > index)
+        events.resize(events.size() - std::min<std::size_t>(events.size(), valid - index));
+
+    std::ranges::reverse(events);
+}
+} // namespace
+
+u64 now()
+{
+    return static_cast<u64>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+void setThreadName(const char* name)
+{
+    auto& buffer = threadBuffer();
+
+    std::scoped_lock lock(registry().mutex);
+    buffer.name = name;
+}
+
+void collect(u64 since, std::vector<ThreadEvents>& result)
+{
+    auto& threads = registry();
+    std::scoped_lock lock(threads.mutex);
+
+    std::size_t used = 0;
+    for (const auto& buffer : threads.threads)
+    {
+        if (buffer->written.load(std::memory_order_relaxed) == 0)
+            continue;
+
+        if (used == result.size())
+            result.emplace_back();
+
+        auto& thread = result[used++];
+        thread.name = buffer->name;
+        copyEvents(*buffer, since, thread.events);
+    }
+
+    result.resize(used);
+}
+
+std::optional<std::string> writeChromeTrace(const std::filesystem::path& path)
+{
+    std::vector<ThreadEvents> threads;
+    collect(0, threads);
+
+    std::ofstream file(path);
+    if (!file)
+        return std::format("Could not open {} for writing", path.string());
+
+    // Zone and thread names are literals of the game, none of them needs escaping
+    file << R"({"displayTimeUnit":"ms","traceEvents":[)";
+    bool first = true;
+    for (std::size_t tid = 0; tid < threads.size(); tid++)
+    {
+        file << std::format(R"({}{{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"{}"}}}})",
+                            first ? "" : ",\n",
+                            tid + 1,
+                            threads[tid].name);
+        first = false;
+
+        for (const auto& event : threads[tid].events)
+        {
+            file << std::format(",\n" R"({{"name":"{}","ph":"X","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f}}})",
+                                event.name,
+                                tid + 1,
+                                static_cast<double>(event.start) / 1000.0,
+                                static_cast<double>(event.end - event.start) / 1000.0);
+        }
+    }
+    file << "]}\n";
+
+    if (!file)
+        return std::format("Could not write {}", path.string());
+
+    return {};
+}
+
+Zone::Zone(const char* name) : mName{name}, mStart{now()}
+{
+    zoneDepth++;
+}
+
+Zone::~Zone()
+{
+    zoneDepth--;
+    record(mName, mStart, now(), zoneDepth);
+}
+} // namespace Profiler
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Scoped timing zones recorded into a ring buffer per thread. LUMIAX_ZONE("name") measures until the end of the
+// enclosing scope, names must be string literals. Builds without LUMIAX_PROFILER compile the macros to nothing, the
+// functions below then report no events.
+namespace Profiler
+{
+// Events per thread kept for the timeline and traces, older ones are overwritten
+constexpr std::size_t ringCapacity = 16384;
+
+struct Event
+{
+    const char* name{};
+    // Nanoseconds since the profiler started
+    u64 start{};
+    u64 end{};
+    // Number of zones the event is nested in
+    u32 depth{};
+};
+
+struct ThreadEvents
+{
+    std::string name;
+    // Ordered by end time, children end before their parents
+    std::vector<Event> events;
+};
+
+// Nanoseconds since the profiler started, the time base of all events
+u64 now();
+
+// Label of the calling thread in the timeline and traces
+void setThreadName(const char* name);
+
+// Copies the events of every thread that ended at or after since. Reuses the storage of result, threads that
+// recorded nothing yet are left out.
+void collect(u64 since, std::vector<ThreadEvents>& result);
+
+// Writes all recorded events in the Chrome trace event format, for chrome://tracing or Perfetto
+std::optional<std::string> writeChromeTrace(const std::filesystem::path& path);
+
+class Zone
+{
+public:
+    explicit Zone(const char* name);
+    ~Zone();
+
+    Zone(const Zone&) = delete;
+    Zone& operator=(const Zone&) = delete;
+
+private:
+    const char* mName;
+    u64 mStart;
+};
+} // namespace Profiler
+
+#ifdef LUMIAX_PROFILER
+#define LUMIAX_PROFILER_CONCAT_INNER(a, b) a##b
+#define LUMIAX_PROFILER_CONCAT(a, b) LUMIAX_PROFILER_CONCAT_INNER(a, b)
+#define LUMIAX_ZONE(name) const Profiler::Zone LUMIAX_PROFILER_CONCAT(profilerZone, __LINE__)(name)
+#define LUMIAX_THREAD_NAME(name) Profiler::setThreadName(name)
+#else
+#define LUMIAX_ZONE(name)
+#define LUMIAX_THREAD_NAME(name)
+#endif
@@ -0,0 +1,155 @@
+#include "profilerPanel.hpp"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <functional>
+#include <string_view>
+
+namespace
+{
+constexpr float rowHeight = 16.f;
+
+// Stable color per zone name, zones with the same name defined in different files share it
+ImU32 zoneColor(const char* name)
+{
+    auto hash = std::hash<std::string_view>{}(name);
+    float hue = static_cast<float>(hash % 360) / 360.f;
+    return ImColor::HSV(hue, 0.55f, 0.7f);
+}
+} // namespace
+
+void ProfilerPanel::draw()
+{
+    ImGui::Begin("Profiler");
+
+#ifndef LUMIAX_PROFILER
+    ImGui::TextUnformatted("Built without LUMIAX_PROFILER, no zones are recorded");
+#else
+    ImGui::Checkbox("Pause", &mPaused);
+    ImGui::SameLine();
+    ImGui::SliderFloat("Window (ms)", &mWindowMs, 5.f, 500.f);
+
+    if (ImGui::Button("Save Chrome trace"))
+    {
+        auto error = Profiler::writeChromeTrace("lumiax_trace.json");
+        mTraceStatus = error.value_or("Saved lumiax_trace.json");
+    }
+    if (!mTraceStatus.empty())
+    {
+        ImGui::SameLine();
+        ImGui::TextUnformatted(mTraceStatus.c_str());
+    }
+
+    auto window = static_cast<u64>(mWindowMs * 1'000'000.f);
+    if (!mPaused)
+    {
+        mEnd = Profiler::now();
+        Profiler::collect(mEnd > window ? mEnd - window : 0, mThreads);
+    }
+    u64 begin = mEnd > window ? mEnd - window : 0;
+
+    drawTimeline(begin, mEnd);
+    drawStats(begin, mEnd);
+#endif
+
+    ImGui::End();
+}
+
+void ProfilerPanel::drawTimeline(u64 begin, u64 end)
+{
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    float width = std::max(ImGui::GetContentRegionAvail().x, 100.f);
+    float scale = width / static_cast<float>(std::max<u64>(end - begin, 1));
+
+    for (const auto& thread : mThreads)
+    {
+        ImGui::TextUnformatted(thread.name.c_str());
+
+        u32 maxDepth = 0;
+        for (const auto& event : thread.events)
+            maxDepth = std::max(maxDepth, event.depth);
+
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        for (const auto& event : thread.events)
+        {
+            if (event.end < begin || event.start > end)
+                continue;
+
+            float left = origin.x + (static_cast<float>(std::max(event.start, begin) - begin) * scale);
+            float right = origin.x + (static_cast<float>(std::min(event.end, end) - begin) * scale);
+            float top = origin.y + (static_cast<float>(event.depth) * rowHeight);
+            ImVec2 min{left, top};
+            ImVec2 max{std::max(right, left + 1.f), top + rowHeight - 1.f};
+
+            drawList->AddRectFilled(min, max, zoneColor(event.name));
+            if (max.x - min.x > 30.f)
+            {
+                drawList->PushClipRect(min, max, true);
+                drawList->AddText({min.x + 2.f, min.y}, IM_COL32_WHITE, event.name);
+                drawList->PopClipRect();
+            }
+
+            if (ImGui::IsMouseHoveringRect(min, max))
+                ImGui::SetTooltip("%s: %.3f ms", event.name, static_cast<double>(event.end - event.start) / 1e6);
+        }
+
+        ImGui::Dummy({width, rowHeight * static_cast<float>(maxDepth + 1)});
+    }
+}
+
+void ProfilerPanel::drawStats(u64 begin, u64 end)
+{
+    for (auto& stats : mStats)
+        stats = {stats.name};
+
+    for (const auto& thread : mThreads)
+    {
+        for (const auto& event : thread.events)
+        {
+            if (event.end < begin || event.end > end)
+                continue;
+
+            auto found = std::ranges::find_if(
+                mStats, [&](const ZoneStats& stats) { return std::string_view(stats.name) == event.name; });
+            auto& stats = found != mStats.end() ? *found : mStats.emplace_back(event.name);
+
+            u64 duration = event.end - event.start;
+            stats.calls++;
+            stats.total += duration;
+            stats.max = std::max(stats.max, duration);
+        }
+    }
+
+    std::ranges::sort(mStats, std::ranges::greater{}, &ZoneStats::total);
+
+    if (!ImGui::BeginTable("Zones", 5))
+        return;
+
+    ImGui::TableSetupColumn("Zone");
+    ImGui::TableSetupColumn("Calls");
+    ImGui::TableSetupColumn("Total ms");
+    ImGui::TableSetupColumn("Avg ms");
+    ImGui::TableSetupColumn("Max ms");
+    ImGui::TableHeadersRow();
+
+    for (const auto& stats : mStats)
+    {
+        if (stats.calls == 0)
+            continue;
+
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(stats.name);
+        ImGui::TableNextColumn();
+        ImGui::Text("%u", stats.calls);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", static_cast<double>(stats.total) / 1e6);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", static_cast<double>(stats.total) / 1e6 / stats.calls);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", static_cast<double>(stats.max) / 1e6);
+    }
+
+    ImGui::EndTable();
+}
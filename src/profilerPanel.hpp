@@ -0,0 +1,36 @@
+#pragma once
+
+#include "profiler.hpp"
+#include "types.hpp"
+
+#include <string>
+#include <vector>
+
+// ImGui window with a rolling timeline of the profiler zones of every thread and statistics per zone
+class ProfilerPanel
+{
+public:
+    // Call between ImGui::SFML::Update and ImGui::SFML::Render
+    void draw();
+
+private:
+    struct ZoneStats
+    {
+        const char* name{};
+        u32 calls{};
+        u64 total{};
+        u64 max{};
+    };
+
+    void drawTimeline(u64 begin, u64 end);
+    void drawStats(u64 begin, u64 end);
+
+    std::vector<Profiler::ThreadEvents> mThreads;
+    std::vector<ZoneStats> mStats;
+    // Length of the timeline
+    float mWindowMs{50.f};
+    bool mPaused{};
+    // End of the timeline in profiler time, frozen while paused
+    u64 mEnd{};
+    std::string mTraceStatus;
+};
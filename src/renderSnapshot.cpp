@@ -0,0 +1,75 @@
+#include "renderSnapshot.hpp"
+
+#include "box2d/b2_body.h"
+#include "box2d/b2_fixture.h"
+#include "box2d/b2_polygon_shape.h"
+
+#include <stdexcept>
+
+sf::Vector2f RenderSnapshot::cameraTarget(float alpha) const
+{
+    if (followedShip >= ships.size())
+        return {};
+
+    const auto& ship = ships[followedShip];
+    Pose pose = interpolate(ship.previous, ship.current, alpha);
+    return pose.position + ship.centerOfMass.rotatedBy(pose.rotation);
+}
+
+Pose interpolate(const Pose& previous, const Pose& current, float alpha)
+{
+    return {previous.position + ((current.position - previous.position) * alpha),
+            previous.rotation + ((current.rotation - previous.rotation) * alpha)};
+}
+
+void capture(const Simulation& simulation, RenderSnapshot& snapshot)
+{
+    snapshot.tick = simulation.tick();
+
+    const auto& ships = simulation.ships();
+    const auto& previousShipPoses = simulation.previousShipPoses();
+    snapshot.ships.resize(ships.size());
+
+    for (std::size_t i = 0; i < ships.size(); i++)
+    {
+        const auto& ship = ships[i];
+        auto& shipSnapshot = snapshot.ships[i];
+
+        const auto* shape = ship.body().GetFixtureList()[0].GetShape();
+        if (shape->GetType() != b2Shape::Type::e_polygon)
+        {
+            throw std::runtime_error("Shape type rendering not implemented!");
+        }
+
+        const auto* polygon = static_cast<const b2PolygonShape*>(shape);
+        for (int32 vertex = 0; vertex < polygon->m_count; vertex++)
+        {
+            shipSnapshot.vertices[vertex] = {polygon->m_vertices[vertex].x, polygon->m_vertices[vertex].y};
+        }
+        shipSnapshot.vertexCount = static_cast<u32>(polygon->m_count);
+
+        shipSnapshot.color = ship.color();
+        shipSnapshot.current = {ship.position(), ship.rotation()};
+        shipSnapshot.previous = i < previousShipPoses.size() ? previousShipPoses[i] : shipSnapshot.current;
+        shipSnapshot.centerOfMass = ship.centerOfMass();
+        shipSnapshot.airResistance = ship.airResistance();
+        shipSnapshot.linearAcceleration = ship.linearAccerleration();
+        shipSnapshot.speed = ship.body().GetLinearVelocity().Length();
+    }
+
+    const auto& level = simulation.level();
+    const auto& rectLayers = level.getRectLayers();
+    const auto& animatedRects = level.animatedRects();
+    const auto& previousRectPoses = simulation.previousRectPoses();
+    snapshot.rects.resize(animatedRects.size());
+
+    for (std::size_t i = 0; i < animatedRects.size(); i++)
+    {
+        const auto& rect = rectLayers[animatedRects[i].layer][animatedRects[i].rect].value;
+        auto& rectSnapshot = snapshot.rects[i];
+
+        rectSnapshot.current = {rect.position, rect.rotation};
+        rectSnapshot.previous = i < previousRectPoses.size() ? previousRectPoses[i] : rectSnapshot.current;
+        rectSnapshot.size = rect.size;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "allocationTracker.hpp"
+#include "box2d/b2_math.h"
+#include "box2d/b2_settings.h"
+#include "simulation.hpp"
+#include "types.hpp"
+
+#include <SFML/Graphics/Color.hpp>
+#include <SFML/System/Angle.hpp>
+#include <SFML/System/Vector2.hpp>
+#include <array>
+#include <chrono>
+#include <vector>
+
+struct ShipSnapshot
+{
+    sf::Color color;
+    // Hull polygon in body space
+    std::array<sf::Vector2f, b2_maxPolygonVertices> vertices{};
+    u32 vertexCount{};
+
+    Pose previous;
+    Pose current;
+    sf::Vector2f centerOfMass;
+
+    b2Vec2 airResistance{};
+    b2Vec2 linearAcceleration{};
+    float speed{};
+};
+
+// Transform of an animated rect, in level pixel units like Level::Rect
+struct RectSnapshot
+{
+    Pose previous;
+    Pose current;
+    sf::Vector2f size;
+};
+
+// Tile edit for renderers that keep their own copy of the tiles
+struct TileChange
+{
+    // First tick whose snapshot carries the change
+    u64 tick{};
+    Level::TileEdit edit;
+};
+
+// Everything the renderer needs from one simulation tick. Copies are owned by the snapshot, so the render thread
+// never touches the b2World while the simulation thread steps it.
+struct RenderSnapshot
+{
+    u64 tick{};
+    // Wall clock time the tick was scheduled for, rendering at this time shows the previous poses
+    std::chrono::steady_clock::time_point time;
+    std::vector<ShipSnapshot> ships;
+    // One entry per animated rect of the level, in the order of Level::animatedRects
+    std::vector<RectSnapshot> rects;
+    // Index of the ship the camera follows
+    u32 followedShip{};
+    // Tile edits the consumer has not acknowledged yet, oldest first. Snapshots the consumer skips lose nothing.
+    std::vector<TileChange> tileChanges;
+    // Level::generation the tile changes were made in
+    u64 tileGeneration{};
+    // Heap allocations of the simulation thread while stepping this tick and capturing the snapshot
+    AllocationTracker::Counts tickAllocations;
+
+    // Center of mass of the followed ship
+    sf::Vector2f cameraTarget(float alpha) const;
+};
+
+// Blends from previous (alpha = 0) to current (alpha = 1). Angles are not wrapped by Box2D, so they are blended
+// linearly as well.
+Pose interpolate(const Pose& previous, const Pose& current, float alpha);
+
+// Overwrites snapshot with the current state of simulation, reusing its storage. The previous poses are those of
+// the tick before.
+void capture(const Simulation& simulation, RenderSnapshot& snapshot);
@@ -0,0 +1,338 @@
+#include "replay.hpp"
+
+#include <array>
+#include <bit>
+#include <format>
+#include <fstream>
+#include <iterator>
+
+#include <cstring>
+
+static_assert(std::endian::native == std::endian::little, "The replay format is little endian");
+
+namespace Replay
+{
+namespace
+{
+class ByteWriter
+{
+public:
+    template <typename T>
+    void write(const T& value)
+    {
+        auto offset = mBuffer.size();
+        mBuffer.resize(offset + sizeof(T));
+        std::memcpy(mBuffer.data() + offset, &value, sizeof(T));
+    }
+
+    // LEB128, run lengths and counts are small most of the time
+    void writeVarint(u64 value)
+    {
+        while (value >= 0x80)
+        {
+            mBuffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        mBuffer.push_back(static_cast<char>(value));
+    }
+
+    const std::vector<char>& buffer() const { return mBuffer; }
+
+private:
+    std::vector<char> mBuffer;
+};
+
+class ByteReader
+{
+public:
+    explicit ByteReader(std::vector<char> buffer) : mBuffer{std::move(buffer)} {}
+
+    template <typename T>
+    bool read(T& value)
+    {
+        if (mBuffer.size() - mOffset < sizeof(T))
+            return false;
+        std::memcpy(&value, mBuffer.data() + mOffset, sizeof(T));
+        mOffset += sizeof(T);
+        return true;
+    }
+
+    bool readVarint(u64& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (mOffset >= mBuffer.size())
+                return false;
+            auto byte = static_cast<u8>(mBuffer[mOffset++]);
+            value |= static_cast<u64>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    bool readString(std::string& value, std::size_t size)
+    {
+        if (mBuffer.size() - mOffset < size)
+            return false;
+        value.assign(mBuffer.data() + mOffset, size);
+        mOffset += size;
+        return true;
+    }
+
+    std::size_t remaining() const { return mBuffer.size() - mOffset; }
+
+private:
+    std::vector<char> mBuffer;
+    std::size_t mOffset{};
+};
+} // namespace
+
+Recorder::Recorder(const Simulation& simulation, std::string levelPath, u32 checksumInterval)
+{
+    mRecording.levelPath = std::move(levelPath);
+    mRecording.fixedStepMicroseconds = simulation.fixedStep().asMicroseconds();
+    mRecording.ships = simulation.shipSpawns();
+    mRecording.checksumInterval = checksumInterval;
+    mRecording.runs.resize(mRecording.ships.size());
+}
+
+void Recorder::record(const TickInput& input, const Simulation& simulation)
+{
+    for (std::size_t shipIndex = 0; shipIndex < mRecording.runs.size(); shipIndex++)
+    {
+        // Ships without input keep their thruster state, which is what the previous run holds
+        auto& runs = mRecording.runs[shipIndex];
+        u8 thrusters = shipIndex < input.ships.size() ? input.ships[shipIndex].thrusters
+                                                      : (runs.empty() ? u8{0} : runs.back().thrusters);
+
+        if (!runs.empty() && runs.back().thrusters == thrusters)
+            runs.back().length++;
+        else
+            runs.push_back({thrusters, 1});
+    }
+
+    for (const auto& command : input.commands)
+        mRecording.commands.push_back({mRecording.tickCount, command});
+
+    mRecording.tickCount++;
+
+    if (mRecording.checksumInterval != 0 && mRecording.tickCount % mRecording.checksumInterval == 0)
+        mRecording.checksums.push_back(simulation.checksum());
+}
+
+Player::Player(const Recording& recording) :
+    mRecording{recording},
+    mRunIndex(recording.runs.size()),
+    mRunRemaining(recording.runs.size())
+{
+    mInput.ships.resize(recording.runs.size());
+
+    for (std::size_t shipIndex = 0; shipIndex < recording.runs.size(); shipIndex++)
+    {
+        if (!recording.runs[shipIndex].empty())
+            mRunRemaining[shipIndex] = recording.runs[shipIndex].front().length;
+    }
+}
+
+const TickInput& Player::next()
+{
+    for (std::size_t shipIndex = 0; shipIndex < mRecording.runs.size(); shipIndex++)
+    {
+        const auto& runs = mRecording.runs[shipIndex];
+
+        while (mRunRemaining[shipIndex] == 0 && mRunIndex[shipIndex] + 1 < runs.size())
+            mRunRemaining[shipIndex] = runs[++mRunIndex[shipIndex]].length;
+
+        if (mRunRemaining[shipIndex] == 0)
+            continue;
+
+        mInput.ships[shipIndex].thrusters = runs[mRunIndex[shipIndex]].thrusters;
+        mRunRemaining[shipIndex]--;
+    }
+
+    mInput.commands.clear();
+    const auto& commands = mRecording.commands;
+    while (mCommandIndex < commands.size() && commands[mCommandIndex].tick <= mTick)
+        mInput.commands.push_back(commands[mCommandIndex++].command);
+
+    mTick++;
+    return mInput;
+}
+
+bool Player::verify(const Simulation& simulation) const
+{
+    u32 interval = mRecording.checksumInterval;
+    if (interval == 0 || mTick % interval != 0)
+        return true;
+
+    auto index = (mTick / interval) - 1;
+    if (index >= mRecording.checksums.size())
+        return true;
+
+    return mRecording.checksums[index] == simulation.checksum();
+}
+
+std::optional<std::string> toFile(const Recording& recording, const std::filesystem::path& path)
+{
+    ByteWriter writer;
+    writer.write(magic);
+    writer.write(version);
+    writer.write(recording.fixedStepMicroseconds);
+    writer.write(recording.tickCount);
+    writer.write(recording.checksumInterval);
+
+    writer.writeVarint(recording.levelPath.size());
+    for (char c : recording.levelPath)
+        writer.write(c);
+
+    writer.writeVarint(recording.ships.size());
+    for (const auto& ship : recording.ships)
+    {
+        writer.write(ship.color.toInteger());
+        writer.write(ship.size.x);
+        writer.write(ship.size.y);
+        writer.write(ship.position.x);
+        writer.write(ship.position.y);
+        writer.write(ship.angle.asRadians());
+    }
+
+    for (const auto& runs : recording.runs)
+    {
+        writer.writeVarint(runs.size());
+        for (const auto& run : runs)
+        {
+            writer.write(run.thrusters);
+            writer.writeVarint(run.length);
+        }
+    }
+
+    writer.writeVarint(recording.checksums.size());
+    for (u64 checksum : recording.checksums)
+        writer.write(checksum);
+
+    // Tick deltas, commands come in bursts while someone uses the debug panel
+    u64 previousTick = 0;
+    writer.writeVarint(recording.commands.size());
+    for (const auto& [tick, command] : recording.commands)
+    {
+        writer.writeVarint(tick - previousTick);
+        previousTick = tick;
+        writer.write(command.type);
+        writer.writeVarint(command.ship);
+        writer.write(command.position.x);
+        writer.write(command.position.y);
+        writer.write(command.radius);
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return std::format("Could not open replay file for writing: {}", path.string());
+
+    file.write(writer.buffer().data(), static_cast<std::streamsize>(writer.buffer().size()));
+    if (!file)
+        return std::format("Could not write replay file: {}", path.string());
+
+    return {};
+}
+
+std::expected<Recording, std::string> fromFile(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return std::unexpected(std::format("Could not open replay file: {}", path.string()));
+
+    ByteReader reader(std::vector<char>(std::istreambuf_iterator<char>(file), {}));
+    auto corrupt = [&] { return std::unexpected(std::format("Replay file is corrupt: {}", path.string())); };
+
+    u32 fileMagic{};
+    u32 fileVersion{};
+    if (!reader.read(fileMagic) || fileMagic != magic)
+        return std::unexpected(std::format("Not a replay file: {}", path.string()));
+    if (!reader.read(fileVersion) || fileVersion == 0 || fileVersion > version)
+        return std::unexpected(std::format("Replay file {} has unsupported version {}", path.string(), fileVersion));
+
+    Recording recording;
+    u64 count{};
+
+    if (!reader.read(recording.fixedStepMicroseconds) || !reader.read(recording.tickCount) ||
+        !reader.read(recording.checksumInterval) || !reader.readVarint(count) ||
+        !reader.readString(recording.levelPath, count) || !reader.readVarint(count))
+    {
+        return corrupt();
+    }
+
+    for (u64 i = 0; i < count; i++)
+    {
+        u32 color{};
+        std::array<float, 5> values{};
+        if (!reader.read(color))
+            return corrupt();
+        for (float& value : values)
+        {
+            if (!reader.read(value))
+                return corrupt();
+        }
+
+        recording.ships.push_back(
+            {sf::Color(color), {values[0], values[1]}, {values[2], values[3]}, sf::radians(values[4])});
+    }
+
+    recording.runs.resize(recording.ships.size());
+    for (auto& runs : recording.runs)
+    {
+        if (!reader.readVarint(count))
+            return corrupt();
+
+        for (u64 i = 0; i < count; i++)
+        {
+            Run run;
+            u64 length{};
+            if (!reader.read(run.thrusters) || !reader.readVarint(length))
+                return corrupt();
+            run.length = static_cast<u32>(length);
+            runs.push_back(run);
+        }
+    }
+
+    if (!reader.readVarint(count) || count > reader.remaining() / sizeof(u64))
+        return corrupt();
+
+    recording.checksums.resize(count);
+    for (u64& checksum : recording.checksums)
+    {
+        if (!reader.read(checksum))
+            return corrupt();
+    }
+
+    if (fileVersion < 2)
+        return recording;
+
+    if (!reader.readVarint(count))
+        return corrupt();
+
+    u64 tick = 0;
+    for (u64 i = 0; i < count; i++)
+    {
+        u64 delta{};
+        u64 ship{};
+        Command command;
+        if (!reader.readVarint(delta) || !reader.read(command.command.type) || !reader.readVarint(ship) ||
+            !reader.read(command.command.position.x) || !reader.read(command.command.position.y) ||
+            !reader.read(command.command.radius))
+        {
+            return corrupt();
+        }
+        if (command.command.type > SimulationCommand::Type::BlastTiles)
+            return corrupt();
+
+        tick += delta;
+        command.tick = tick;
+        command.command.ship = static_cast<u32>(ship);
+        recording.commands.push_back(command);
+    }
+
+    return recording;
+}
+} // namespace Replay
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "simulation.hpp"
+#include "types.hpp"
+
+#include <expected>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Recorded sessions: per ship run length encoded thruster states, commands and periodic state checksums
+namespace Replay
+{
+constexpr u32 magic = 0x524c4d4c; // "LMLR"
+// Version 1 files have no commands and are still read
+constexpr u32 version = 2;
+
+struct Run
+{
+    u8 thrusters{};
+    u32 length{};
+};
+
+struct Command
+{
+    // Zero based tick the command was applied in
+    u64 tick{};
+    SimulationCommand command;
+};
+
+struct Recording
+{
+    std::string levelPath;
+    i64 fixedStepMicroseconds{};
+    std::vector<ShipSpawn> ships;
+    u64 tickCount{};
+    // checksums[i] is Simulation::checksum() after tick (i + 1) * checksumInterval
+    u32 checksumInterval{};
+    std::vector<u64> checksums;
+    // One run list per ship
+    std::vector<std::vector<Run>> runs;
+    // In tick order
+    std::vector<Command> commands;
+};
+
+class Recorder
+{
+public:
+    // Starts recording a simulation that has not been stepped yet
+    Recorder(const Simulation& simulation, std::string levelPath, u32 checksumInterval = 60);
+
+    // Call after simulation.step(input)
+    void record(const TickInput& input, const Simulation& simulation);
+
+    const Recording& recording() const { return mRecording; }
+
+private:
+    Recording mRecording;
+};
+
+class Player
+{
+public:
+    explicit Player(const Recording& recording);
+
+    bool finished() const { return mTick >= mRecording.tickCount; }
+
+    // Input of the next tick, only valid while not finished
+    const TickInput& next();
+
+    // Compares against the recorded checksum if one exists for the current tick, call after simulation.step
+    bool verify(const Simulation& simulation) const;
+
+private:
+    const Recording& mRecording;
+    u64 mTick{};
+    TickInput mInput;
+    std::vector<std::size_t> mRunIndex;
+    std::vector<u32> mRunRemaining;
+    std::size_t mCommandIndex{};
+};
+
+std::optional<std::string> toFile(const Recording& recording, const std::filesystem::path& path);
+std::expected<Recording, std::string> fromFile(const std::filesystem::path& path);
+} // namespace Replay
@@ -0,0 +1,150 @@
+#include "gameServer.hpp"
+#include "levelBinary.hpp"
+#include "levelParser.hpp"
+#include "log.hpp"
+#include "simulation.hpp"
+
+#include <charconv>
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <print>
+#include <span>
+#include <string_view>
+#include <thread>
+
+namespace
+{
+bool parseInt(std::string_view text, int& value)
+{
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc{} && ptr == text.data() + text.size() && value > 0;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::span args(argv, static_cast<std::size_t>(argc));
+
+    std::filesystem::path levelPath = "../../data/levels/level01.json";
+    int port = NetProtocol::defaultPort;
+    int tickRate = 60;
+    // Meters around the ships that keep tile collision, 0 loads the whole level
+    int streamRadius = 0;
+    std::optional<std::filesystem::path> logPath;
+
+    bool validArgs = args.size() % 2 == 1;
+    for (std::size_t i = 1; validArgs && i + 1 < args.size(); i += 2)
+    {
+        std::string_view name(args[i]);
+        std::string_view value(args[i + 1]);
+
+        if (name == "--level")
+            levelPath = value;
+        else if (name == "--port")
+            validArgs = parseInt(value, port) && port <= 65535;
+        else if (name == "--tick-rate")
+            validArgs = parseInt(value, tickRate);
+        else if (name == "--stream")
+            validArgs = parseInt(value, streamRadius);
+        else if (name == "--log")
+            logPath = value;
+        else if (name == "--log-level")
+        {
+            auto severity = Log::parseSeverity(value);
+            validArgs = severity.has_value();
+            if (validArgs)
+                Log::setMinimumSeverity(*severity);
+        }
+        else
+            validArgs = false;
+    }
+
+    if (!validArgs)
+    {
+        std::println(std::cerr,
+                     "Usage: {} [--level <level>] [--port <port>] [--tick-rate <hz>] [--stream <meters>] "
+                     "[--log <file>] [--log-level <debug|info|warning|error>]",
+                     args[0]);
+        return 1;
+    }
+
+    if (logPath.has_value())
+    {
+        if (auto error = Log::openFile(*logPath); error.has_value())
+        {
+            std::println(std::cerr, "{}", *error);
+            return 1;
+        }
+    }
+
+    std::expected<Level, std::string> levelResult = std::unexpected(std::string{});
+    auto sourceLevelPath = std::filesystem::path(levelPath).replace_extension(".json");
+    if (levelPath.extension() != ".lvl")
+    {
+        levelResult = LevelParser::fromFile(levelPath);
+    }
+    else if (LevelBinary::isCurrent(levelPath) || !std::filesystem::exists(sourceLevelPath))
+    {
+        levelResult = LevelBinary::fromFile(levelPath);
+    }
+    else
+    {
+        // Compiled by another version or older than its sources
+        Log::warning("Level", "{} is stale, loading {}", levelPath.string(), sourceLevelPath.string());
+        levelResult = LevelParser::fromFile(sourceLevelPath);
+    }
+    if (!levelResult.has_value())
+    {
+        Log::error("Level", "Failed to load level: {}", levelResult.error());
+        return 1;
+    }
+
+    sf::Time fixedStep = sf::seconds(1.f / static_cast<float>(tickRate));
+    std::optional<ChunkStreamer::Settings> streaming;
+    if (streamRadius > 0)
+    {
+        auto radius = static_cast<float>(streamRadius);
+        streaming = ChunkStreamer::Settings{.loadRadius = radius, .unloadRadius = radius * 1.5f};
+    }
+    Simulation simulation(std::move(levelResult.value()), fixedStep, streaming);
+
+    auto server = GameServer::bind(simulation, static_cast<u16>(port));
+    if (!server.has_value())
+    {
+        Log::error("Network", "{}", server.error());
+        return 1;
+    }
+
+    Log::info("Network", "Serving {} on UDP port {} at {} Hz", levelPath.string(), server->port(), tickRate);
+
+    using Clock = std::chrono::steady_clock;
+    auto tickDuration = std::chrono::duration_cast<Clock::duration>(fixedStep.toDuration());
+    auto nextTick = Clock::now();
+
+    std::chrono::nanoseconds busy{};
+    std::chrono::nanoseconds slowest{};
+
+    while (true)
+    {
+        auto duration = server->tick();
+        busy += duration;
+        slowest = std::max(slowest, duration);
+
+        // Status line every ten seconds
+        if (simulation.tick() % static_cast<u64>(tickRate * 10) == 0)
+        {
+            Log::info("Network",
+                      "Tick {}: {} clients, average tick {} us, slowest {} us",
+                      simulation.tick(),
+                      server->clientCount(),
+                      std::chrono::duration_cast<std::chrono::microseconds>(busy).count() / (tickRate * 10),
+                      std::chrono::duration_cast<std::chrono::microseconds>(slowest).count());
+            busy = {};
+            slowest = {};
+        }
+
+        nextTick = std::max(nextTick + tickDuration, Clock::now() - (tickDuration * 5));
+        std::this_thread::sleep_until(nextTick);
+    }
+}
@@ -44,6 +44,10 @@ public:
     void update();
 
     const b2Body& body() const { return *mBody; }
+    b2Body& body() { return *mBody; }
+
+    float linearThrusterAcceleration() const { return mLinearThrusterAcceleration; }
+    float angularThrusterAcceleration() const { return mAngularThrusterAccerlaration; }
 
     b2Vec2 airResistance() const;
     b2Vec2 linearAccerleration() const;
@@ -1,43 +1,29 @@
 #include "shipRenderer.hpp"
 
-#include "box2d/b2_body.h"
-#include "box2d/b2_fixture.h"
-#include "box2d/b2_shape.h"
-#include "box2d/b2_polygon_shape.h"
-#include "ship.hpp"
-#include <stdexcept>
+#include "renderSnapshot.hpp"
+
+#include <SFML/Graphics/Transform.hpp>
 
 void ShipRenderer::reset()
 {
     mVertices.clear();
 }
 
-void ShipRenderer::drawShip(const Ship& ship)
+void ShipRenderer::drawShip(const ShipSnapshot& ship, float alpha)
 {
+    Pose pose = interpolate(ship.previous, ship.current, alpha);
+
     sf::Transform transform;
-    transform.translate(ship.position());
-    transform.rotate(ship.rotation());
+    transform.translate(pose.position);
+    transform.rotate(pose.rotation);
 
     mVertices.setPrimitiveType(sf::PrimitiveType::Triangles);
     auto oldSize = mVertices.getVertexCount();
 
-    const auto& body = ship.body();
-    const auto* shape = body.GetFixtureList()[0].GetShape();
-
-    if (shape->GetType() == b2Shape::Type::e_polygon)
-    {
-        const auto* polygon = static_cast<const b2PolygonShape*>(shape);
-
-        mVertices.resize(oldSize + polygon->m_count);
+    mVertices.resize(oldSize + ship.vertexCount);
 
-        for (int32 i = 0; i < polygon->m_count; i++)
-        {
-            b2Vec2 pos = body.GetWorldPoint(polygon->m_vertices[i]);
-            mVertices[oldSize + i] = sf::Vertex{{pos.x, pos.y}, ship.color()};
-        }
-    }
-    else
+    for (u32 i = 0; i < ship.vertexCount; i++)
     {
-        throw std::runtime_error("Shape type rendering not implemented!");
+        mVertices[oldSize + i] = sf::Vertex{transform.transformPoint(ship.vertices[i]), ship.color};
     }
 }
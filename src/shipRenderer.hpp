@@ -2,13 +2,14 @@
 
 #include <SFML/Graphics/VertexArray.hpp>
 
-class Ship;
+struct ShipSnapshot;
 
 class ShipRenderer
 {
 public:
     void reset();
-    void drawShip(const Ship& ship);
+    // alpha blends between the ship's previous and current pose
+    void drawShip(const ShipSnapshot& ship, float alpha);
 
     const sf::VertexArray& vertexArray() const { return mVertices; }
 
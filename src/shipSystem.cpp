@@ -0,0 +1,94 @@
+#include "shipSystem.hpp"
+
+#include "box2d/b2_body.h"
+#include "ship.hpp"
+
+#include <cmath>
+
+namespace
+{
+float thrusterBit(u8 mask, Ship::Direction dir)
+{
+    return static_cast<float>((mask >> static_cast<unsigned>(dir)) & 1u);
+}
+} // namespace
+
+u32 ShipSystem::add(b2Body* body, float linearThrust, float angularThrust)
+{
+    auto ship = static_cast<u32>(mBodies.size());
+
+    mBodies.push_back(body);
+    mThrusters.push_back(0);
+    mLinearThrust.push_back(linearThrust);
+    mAngularThrust.push_back(angularThrust);
+
+    std::size_t count = mBodies.size();
+    mAngle.resize(count);
+    mVelocityX.resize(count);
+    mVelocityY.resize(count);
+    mForwardThrust.resize(count);
+    mForceX.resize(count);
+    mForceY.resize(count);
+    mTorque.resize(count);
+
+    return ship;
+}
+
+void ShipSystem::update()
+{
+    const std::size_t count = mBodies.size();
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const b2Body* body = mBodies[i];
+        mAngle[i] = body->GetAngle();
+        mVelocityX[i] = body->GetLinearVelocity().x;
+        mVelocityY[i] = body->GetLinearVelocity().y;
+    }
+
+    // Thruster bits to signed thrust, branch free so it vectorizes
+    for (std::size_t i = 0; i < count; i++)
+    {
+        u8 mask = mThrusters[i];
+        mForwardThrust[i] =
+            (thrusterBit(mask, Ship::Direction::Up) - thrusterBit(mask, Ship::Direction::Down)) * mLinearThrust[i];
+        mTorque[i] =
+            (thrusterBit(mask, Ship::Direction::Right) - thrusterBit(mask, Ship::Direction::Left)) * mAngularThrust[i];
+    }
+
+    // Forward thrust along the nose, sin and cos are only evaluated for ships that are thrusting
+    for (std::size_t i = 0; i < count; i++)
+    {
+        mForceX[i] = 0.f;
+        mForceY[i] = 0.f;
+        if (mForwardThrust[i] != 0.f)
+        {
+            mForceX[i] = std::sin(mAngle[i]) * mForwardThrust[i];
+            mForceY[i] = -std::cos(mAngle[i]) * mForwardThrust[i];
+        }
+    }
+
+    // Quadratic drag against the velocity, same constants and operation order as Ship::airResistance
+    constexpr float airDensity = 1.2f;
+    constexpr float crossSection = 1.0f;
+    constexpr float dragCoefficient = 0.03f;
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        float vSquared = (mVelocityX[i] * mVelocityX[i]) + (mVelocityY[i] * mVelocityY[i]);
+        if (vSquared < 0.00001f)
+            continue;
+
+        float dragForce = 0.5f * airDensity * vSquared * dragCoefficient * crossSection;
+        float v = std::sqrt(vSquared);
+
+        mForceX[i] += -(mVelocityX[i] / v) * dragForce;
+        mForceY[i] += -(mVelocityY[i] / v) * dragForce;
+    }
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        mBodies[i]->ApplyForceToCenter({mForceX[i], mForceY[i]}, true);
+        mBodies[i]->ApplyTorque(mTorque[i], true);
+    }
+}
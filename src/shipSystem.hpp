@@ -0,0 +1,40 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <vector>
+
+class b2Body;
+
+// Thrust and quadratic drag of all ships, the batched equivalent of calling Ship::update on every ship. Parameters
+// and the body state gathered each update are stored as structure of arrays, so thrust and drag run as plain loops
+// over floats and the forces are applied in one pass afterwards. Produces bit identical forces to Ship::update.
+class ShipSystem
+{
+public:
+    u32 add(b2Body* body, float linearThrust, float angularThrust);
+
+    // One bit per Ship::Direction, see ShipInput
+    void thrusters(u32 ship, u8 mask) { mThrusters[ship] = mask; }
+    u8 thrusters(u32 ship) const { return mThrusters[ship]; }
+
+    void update();
+
+    std::size_t size() const { return mBodies.size(); }
+
+private:
+    // Per ship parameters
+    std::vector<b2Body*> mBodies;
+    std::vector<u8> mThrusters;
+    std::vector<float> mLinearThrust;
+    std::vector<float> mAngularThrust;
+
+    // Per ship state, rewritten every update
+    std::vector<float> mAngle;
+    std::vector<float> mVelocityX;
+    std::vector<float> mVelocityY;
+    std::vector<float> mForwardThrust;
+    std::vector<float> mForceX;
+    std::vector<float> mForceY;
+    std::vector<float> mTorque;
+};
@@ -0,0 +1,492 @@
+#include "simulation.hpp"
+
+#include "box2d/b2_body.h"
+#include "box2d/b2_contact.h"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <ranges>
+#include <span>
+
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+// Sequential memcpy access to SimulationState::mBuffer, which save sized for everything written
+class StateWriter
+{
+public:
+    explicit StateWriter(std::vector<std::byte>& buffer) : mBuffer{buffer} {}
+
+    template <typename T>
+    void write(const T& value)
+    {
+        write(std::span<const T>(&value, 1));
+    }
+
+    template <typename T>
+    void write(std::span<const T> values)
+    {
+        if (!values.empty())
+            std::memcpy(mBuffer.data() + mOffset, values.data(), values.size_bytes());
+        mOffset += values.size_bytes();
+    }
+
+private:
+    std::vector<std::byte>& mBuffer;
+    std::size_t mOffset{};
+};
+
+class StateReader
+{
+public:
+    explicit StateReader(const std::vector<std::byte>& buffer) : mBuffer{buffer} {}
+
+    template <typename T>
+    T read()
+    {
+        T value = readAt<T>(mOffset, 0);
+        mOffset += sizeof(T);
+        return value;
+    }
+
+    // Element index of an array of T starting at offset
+    template <typename T>
+    T readAt(std::size_t offset, std::size_t index) const
+    {
+        T value{};
+        if (offset + ((index + 1) * sizeof(T)) <= mBuffer.size())
+            std::memcpy(&value, mBuffer.data() + offset + (index * sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    void skip(std::size_t size) { mOffset += size; }
+    std::size_t offset() const { return mOffset; }
+
+private:
+    const std::vector<std::byte>& mBuffer;
+    std::size_t mOffset{};
+};
+
+u32 fixtureOrdinal(const b2Fixture* fixture)
+{
+    u32 ordinal = 0;
+    for (const b2Fixture* other = fixture->GetBody()->GetFixtureList(); other != fixture; other = other->GetNext())
+        ordinal++;
+    return ordinal;
+}
+} // namespace
+
+void ShipInput::set(Ship::Direction dir, bool state)
+{
+    auto bit = static_cast<u8>(1u << static_cast<unsigned>(dir));
+    thrusters = state ? (thrusters | bit) : (thrusters & ~bit);
+}
+
+bool ShipInput::get(Ship::Direction dir) const
+{
+    return (thrusters & (1u << static_cast<unsigned>(dir))) != 0;
+}
+
+Simulation::Simulation(Level level, sf::Time fixedStep, std::optional<ChunkStreamer::Settings> streaming) :
+    mFixedStep{fixedStep},
+    mLevel{std::move(level)}
+{
+    if (!streaming.has_value())
+    {
+        mLevel.registerCollision(mWorld);
+        return;
+    }
+
+    mLevel.registerRectCollisions(mWorld);
+    mChunkStreamer = std::make_unique<ChunkStreamer>(mLevel, *streaming);
+}
+
+Ship& Simulation::addShip(sf::Color color, sf::Vector2f size, sf::Vector2f position, sf::Angle angle)
+{
+    mShipSpawns.push_back({color, size, position, angle});
+    auto& ship = mShips.emplace_back(createTriangleShip(mWorld, color, size, position, angle));
+    mShipSystem.add(&ship.body(), ship.linearThrusterAcceleration(), ship.angularThrusterAcceleration());
+    return ship;
+}
+
+Level::Changes Simulation::reloadLevel(Level fresh)
+{
+    auto changes = mLevel.reload(std::move(fresh));
+
+    if (mChunkStreamer != nullptr && changes.chunkLayout)
+    {
+        // Regions are indexed by the chunk layout, so the streamer starts over
+        auto settings = mChunkStreamer->settings();
+        mChunkStreamer->unloadAll(mWorld);
+        mChunkStreamer = std::make_unique<ChunkStreamer>(mLevel, settings);
+    }
+    else if (mChunkStreamer != nullptr && !changes.collisionRects.empty())
+    {
+        mChunkStreamer->invalidate(changes.collisionRects, mLevel, mWorld);
+    }
+
+    // Rect poses of the previous tick no longer line up with the rects
+    if (changes.rectLayout)
+        mPreviousRectPoses.clear();
+
+    return changes;
+}
+
+u64 Simulation::checksum() const
+{
+    // FNV-1a over the bit patterns, any difference in floating point state changes the result
+    u64 hash = 14695981039346656037ull;
+    auto mix = [&hash](float value)
+    {
+        auto bits = std::bit_cast<u32>(value);
+        for (int byte = 0; byte < 4; byte++)
+        {
+            hash ^= (bits >> (byte * 8)) & 0xffu;
+            hash *= 1099511628211ull;
+        }
+    };
+
+    for (const b2Body* body = mWorld.GetBodyList(); body != nullptr; body = body->GetNext())
+    {
+        if (body->GetType() == b2_staticBody)
+            continue;
+
+        const auto& transform = body->GetTransform();
+        mix(transform.p.x);
+        mix(transform.p.y);
+        mix(body->GetAngle());
+        mix(body->GetLinearVelocity().x);
+        mix(body->GetLinearVelocity().y);
+        mix(body->GetAngularVelocity());
+    }
+
+    return hash;
+}
+
+SimulationState::Header SimulationState::header() const
+{
+    Header value;
+    if (mBuffer.size() >= sizeof(Header))
+        std::memcpy(&value, mBuffer.data(), sizeof(Header));
+    return value;
+}
+
+void Simulation::indexBodies() const
+{
+    // Static ids stay below Level::rectBodyFlag << 1, the ordinals of moving bodies get the bit above
+    constexpr u32 movingBodyFlag = static_cast<u32>(Level::rectBodyFlag) << 1;
+
+    mBodyKeys.clear();
+    u32 ordinal = 0;
+    for (b2Body* body = const_cast<b2World&>(mWorld).GetBodyList(); body != nullptr; body = body->GetNext())
+    {
+        // Box2D 2.4 has no const GetUserData
+        u32 key = body->GetType() == b2_staticBody ? static_cast<u32>(body->GetUserData().pointer)
+                                                   : movingBodyFlag | ordinal++;
+        mBodyKeys.emplace_back(body, key);
+    }
+    std::ranges::sort(mBodyKeys, {}, &std::pair<const b2Body*, u32>::first);
+}
+
+u32 Simulation::bodyKey(const b2Body* body) const
+{
+    return std::ranges::lower_bound(mBodyKeys, body, {}, &std::pair<const b2Body*, u32>::first)->second;
+}
+
+void Simulation::save(SimulationState& state) const
+{
+    indexBodies();
+
+    // Contacts go first, their count is needed to lay out the buffer
+    mSavedContacts.clear();
+    for (const b2Contact* contact = mWorld.GetContactList(); contact != nullptr; contact = contact->GetNext())
+    {
+        if (!contact->IsTouching())
+            continue;
+
+        const b2Manifold* manifold = contact->GetManifold();
+        SimulationState::Contact saved{bodyKey(contact->GetFixtureA()->GetBody()),
+                                       fixtureOrdinal(contact->GetFixtureA()),
+                                       bodyKey(contact->GetFixtureB()->GetBody()),
+                                       fixtureOrdinal(contact->GetFixtureB()),
+                                       contact->GetChildIndexA(),
+                                       contact->GetChildIndexB(),
+                                       manifold->pointCount};
+        for (int32 point = 0; point < manifold->pointCount; point++)
+        {
+            saved.ids[point] = manifold->points[point].id.key;
+            saved.normalImpulses[point] = manifold->points[point].normalImpulse;
+            saved.tangentImpulses[point] = manifold->points[point].tangentImpulse;
+        }
+        mSavedContacts.push_back(saved);
+    }
+    std::ranges::sort(mSavedContacts, {}, &SimulationState::Contact::key);
+
+    SimulationState::Header header{.tick = mTick,
+                                   .contactCount = static_cast<u32>(mSavedContacts.size()),
+                                   .thrusterCount = static_cast<u32>(mShipSystem.size()),
+                                   .rectCount = static_cast<u32>(mLevel.animatedRects().size())};
+    for (const b2Body* body = mWorld.GetBodyList(); body != nullptr; body = body->GetNext())
+    {
+        if (body->GetType() != b2_staticBody)
+            header.bodyCount++;
+    }
+
+    state.mBuffer.resize(sizeof(header) + (header.bodyCount * sizeof(SimulationState::Body)) +
+                         (header.contactCount * sizeof(SimulationState::Contact)) + header.thrusterCount +
+                         (header.rectCount * sizeof(Pose)));
+    StateWriter writer(state.mBuffer);
+    writer.write(header);
+
+    for (const b2Body* body = mWorld.GetBodyList(); body != nullptr; body = body->GetNext())
+    {
+        if (body->GetType() == b2_staticBody)
+            continue;
+
+        writer.write(SimulationState::Body{body->GetPosition(),
+                                           body->GetAngle(),
+                                           body->GetLinearVelocity(),
+                                           body->GetAngularVelocity(),
+                                           body->IsAwake()});
+    }
+
+    writer.write(std::span<const SimulationState::Contact>(mSavedContacts));
+
+    for (u32 ship = 0; ship < header.thrusterCount; ship++)
+        writer.write(mShipSystem.thrusters(ship));
+
+    const auto& animatedRects = mLevel.animatedRects();
+    const auto& rectLayers = mLevel.getRectLayers();
+    for (const auto& animatedRect : animatedRects)
+    {
+        const auto& rect = rectLayers[animatedRect.layer][animatedRect.rect].value;
+        writer.write(Pose{rect.position, rect.rotation});
+    }
+}
+
+void Simulation::restore(const SimulationState& state)
+{
+    StateReader reader(state.mBuffer);
+    auto header = reader.read<SimulationState::Header>();
+    mTick = header.tick;
+
+    // Moving bodies are only created while loading and by Level::reload, so they have the same order as when
+    // saving. Static bodies come and go with tile edits and streaming, they are skipped.
+    u32 bodyIndex = 0;
+    for (b2Body* body = mWorld.GetBodyList(); body != nullptr && bodyIndex < header.bodyCount; body = body->GetNext())
+    {
+        if (body->GetType() == b2_staticBody)
+            continue;
+
+        auto saved = reader.read<SimulationState::Body>();
+        bodyIndex++;
+
+        // Moving a body updates its broadphase proxies, skip the ones that did not move since saving
+        if (body->GetPosition() != saved.position || body->GetAngle() != saved.angle)
+            body->SetTransform(saved.position, saved.angle);
+
+        // Putting a body to sleep clears its velocities, so the awake state goes first
+        body->SetAwake(saved.awake);
+        body->SetLinearVelocity(saved.linearVelocity);
+        body->SetAngularVelocity(saved.angularVelocity);
+    }
+    reader.skip((header.bodyCount - bodyIndex) * sizeof(SimulationState::Body));
+
+    // Contacts still existing get their warm starting impulses back, new ones start from zero like after creation
+    indexBodies();
+    std::size_t contactsOffset = reader.offset();
+    auto savedKey = [&](u32 index) { return reader.readAt<SimulationState::Contact>(contactsOffset, index).key(); };
+    auto savedIndices = std::views::iota(u32{0}, header.contactCount);
+    for (b2Contact* contact = mWorld.GetContactList(); contact != nullptr; contact = contact->GetNext())
+    {
+        b2Manifold* manifold = contact->GetManifold();
+        auto key = std::tuple{bodyKey(contact->GetFixtureA()->GetBody()),
+                              fixtureOrdinal(contact->GetFixtureA()),
+                              bodyKey(contact->GetFixtureB()->GetBody()),
+                              fixtureOrdinal(contact->GetFixtureB()),
+                              contact->GetChildIndexA(),
+                              contact->GetChildIndexB()};
+        auto found = std::ranges::lower_bound(savedIndices, key, {}, savedKey);
+        SimulationState::Contact savedContact;
+        if (found != savedIndices.end() && savedKey(*found) == key)
+            savedContact = reader.readAt<SimulationState::Contact>(contactsOffset, *found);
+
+        for (int32 point = 0; point < manifold->pointCount; point++)
+        {
+            auto& manifoldPoint = manifold->points[point];
+            manifoldPoint.normalImpulse = 0.f;
+            manifoldPoint.tangentImpulse = 0.f;
+
+            for (int32 savedPoint = 0; savedPoint < savedContact.pointCount; savedPoint++)
+            {
+                if (savedContact.ids[savedPoint] == manifoldPoint.id.key)
+                {
+                    manifoldPoint.normalImpulse = savedContact.normalImpulses[savedPoint];
+                    manifoldPoint.tangentImpulse = savedContact.tangentImpulses[savedPoint];
+                }
+            }
+        }
+    }
+    reader.skip(header.contactCount * sizeof(SimulationState::Contact));
+
+    for (std::size_t ship = 0; ship < header.thrusterCount; ship++)
+    {
+        ShipInput input{reader.read<u8>()};
+        if (ship >= mShips.size())
+            continue;
+
+        for (auto dir : {Ship::Direction::Left, Ship::Direction::Up, Ship::Direction::Right, Ship::Direction::Down})
+            mShips[ship].thruster(dir, input.get(dir));
+
+        mShipSystem.thrusters(static_cast<u32>(ship), input.thrusters);
+    }
+
+    const auto& animatedRects = mLevel.animatedRects();
+    auto& rectLayers = mLevel.getRects();
+    for (std::size_t rectIndex = 0; rectIndex < animatedRects.size() && rectIndex < header.rectCount; rectIndex++)
+    {
+        auto pose = reader.read<Pose>();
+        auto& rect = rectLayers[animatedRects[rectIndex].layer][animatedRects[rectIndex].rect].value;
+        rect.position = pose.position;
+        rect.rotation = pose.rotation;
+    }
+
+    // Interpolating across a rewind would blend unrelated poses
+    mPreviousShipPoses.clear();
+    mPreviousRectPoses.clear();
+}
+
+void Simulation::apply(const SimulationCommand& command)
+{
+    if (command.ship >= mShips.size())
+        return;
+
+    auto& ship = mShips[command.ship];
+    switch (command.type)
+    {
+    case SimulationCommand::Type::MoveShip:
+        ship.position(command.position);
+        break;
+    case SimulationCommand::Type::BlastTiles:
+    {
+        // The tile collision phase of the same tick repairs the cleared tiles
+        auto center = ship.position();
+        for (int y = -command.radius; y <= command.radius; y++)
+        {
+            for (int x = -command.radius; x <= command.radius; x++)
+            {
+                int tileX = static_cast<int>(std::round(center.x)) + x;
+                int tileY = static_cast<int>(std::round(center.y)) + y;
+                for (std::size_t layer = 0; layer < mLevel.getTileLayers().size(); layer++)
+                    mLevel.setTile(static_cast<unsigned>(layer), tileX, tileY, 0);
+            }
+        }
+        break;
+    }
+    }
+}
+
+void Simulation::step(const TickInput& input)
+{
+    step(input, nullptr);
+}
+
+void Simulation::step(const TickInput& input, StepTimings& timings)
+{
+    step(input, &timings);
+}
+
+void Simulation::step(const TickInput& input, StepTimings* timings)
+{
+    using Clock = std::chrono::steady_clock;
+    auto measure = [timings](std::chrono::nanoseconds StepTimings::*phase, Clock::time_point& start)
+    {
+        if (timings == nullptr)
+            return;
+        auto now = Clock::now();
+        timings->*phase = now - start;
+        start = now;
+    };
+    Clock::time_point start = timings != nullptr ? Clock::now() : Clock::time_point{};
+
+    LUMIAX_ZONE("Simulation::step");
+
+    for (const auto& command : input.commands)
+        apply(command);
+
+    // Tile bodies only change between ticks, never while the world is stepping. Edits made since the last tick,
+    // e.g. by game logic through level(), are repaired first.
+    {
+        LUMIAX_ZONE("Tile collision");
+
+        if (!mLevel.dirtyTiles().empty())
+        {
+            if (mChunkStreamer != nullptr)
+                mChunkStreamer->invalidate(mLevel.dirtyTiles(), mLevel, mWorld);
+            mLevel.repairTileCollision();
+        }
+
+        if (mChunkStreamer != nullptr)
+        {
+            mFocusPoints.clear();
+            for (const auto& ship : mShips)
+                mFocusPoints.push_back(ship.position());
+            mChunkStreamer->update(mFocusPoints, mLevel, mWorld);
+        }
+    }
+
+    measure(&StepTimings::tileCollision, start);
+
+    mPreviousShipPoses.resize(mShips.size());
+    for (std::size_t shipIndex = 0; shipIndex < mShips.size(); shipIndex++)
+        mPreviousShipPoses[shipIndex] = {mShips[shipIndex].position(), mShips[shipIndex].rotation()};
+
+    const auto& animatedRects = mLevel.animatedRects();
+    const auto& rectLayers = mLevel.getRectLayers();
+    mPreviousRectPoses.resize(animatedRects.size());
+    for (std::size_t rectIndex = 0; rectIndex < animatedRects.size(); rectIndex++)
+    {
+        const auto& rect = rectLayers[animatedRects[rectIndex].layer][animatedRects[rectIndex].rect].value;
+        mPreviousRectPoses[rectIndex] = {rect.position, rect.rotation};
+    }
+
+    {
+        LUMIAX_ZONE("Ship::update");
+
+        for (std::size_t shipIndex = 0; shipIndex < mShips.size() && shipIndex < input.ships.size(); shipIndex++)
+        {
+            // Ship keeps its own copy of the thruster state for inspection
+            for (auto dir :
+                 {Ship::Direction::Left, Ship::Direction::Up, Ship::Direction::Right, Ship::Direction::Down})
+                mShips[shipIndex].thruster(dir, input.ships[shipIndex].get(dir));
+
+            mShipSystem.thrusters(static_cast<u32>(shipIndex), input.ships[shipIndex].thrusters);
+        }
+
+        mShipSystem.update();
+    }
+
+    measure(&StepTimings::shipUpdate, start);
+
+    mTick++;
+
+    {
+        LUMIAX_ZONE("Level::updateAnimations");
+        mLevel.updateAnimations(gameTime(), mFixedStep);
+    }
+
+    measure(&StepTimings::animations, start);
+
+    int32 velocityIterations = 8;
+    int32 positionIterations = 3;
+
+    {
+        LUMIAX_ZONE("b2World::Step");
+        mWorld.Step(mFixedStep.asSeconds(), velocityIterations, positionIterations);
+    }
+
+    measure(&StepTimings::physics, start);
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include "box2d/b2_world.h"
+#include "chunkStreamer.hpp"
+#include "level.hpp"
+#include "ship.hpp"
+#include "shipSystem.hpp"
+#include "types.hpp"
+
+#include <SFML/System/Time.hpp>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+class b2Body;
+
+struct ShipInput
+{
+    // One bit per Ship::Direction
+    u8 thrusters{};
+
+    void set(Ship::Direction dir, bool state);
+    bool get(Ship::Direction dir) const;
+};
+
+// Debug edits applied at the start of a tick. They travel with the input, so recordings replay them.
+struct SimulationCommand
+{
+    enum class Type : u8
+    {
+        // Teleports ship to position
+        MoveShip,
+        // Clears the tiles of all layers within radius tiles around ship
+        BlastTiles,
+    };
+
+    Type type{};
+    u32 ship{};
+    sf::Vector2f position;
+    i32 radius{};
+};
+
+struct TickInput
+{
+    std::vector<ShipInput> ships;
+    // Applied in order, commands for ships that do not exist are ignored
+    std::vector<SimulationCommand> commands;
+};
+
+struct ShipSpawn
+{
+    sf::Color color;
+    sf::Vector2f size;
+    sf::Vector2f position;
+    sf::Angle angle;
+};
+
+// Transform of a ship or animated rect. Rects use level pixel units like Level::Rect.
+struct Pose
+{
+    sf::Vector2f position;
+    sf::Angle rotation;
+};
+
+// Mutable state of a Simulation for rollback, kept in one flat buffer that save overwrites without allocating once it
+// has grown to size. Static bodies and tiles are left out, so the size only depends on the number of ships, animated
+// rects and contacts, and restoring does not undo Level::setTile. A state can only be restored into the Simulation
+// that saved it.
+class SimulationState
+{
+public:
+    // Non static bodies in body list order
+    struct Body
+    {
+        b2Vec2 position{};
+        float angle{};
+        b2Vec2 linearVelocity{};
+        float angularVelocity{};
+        bool awake{};
+    };
+
+    // Accumulated impulses of a touching contact, used to warm start the solver. Fixtures are identified by a key
+    // of their body and their ordinal within that body. Moving bodies are keyed by their ordinal among the moving
+    // bodies of the world's body list, static bodies by the id in their userData, see Level::rectBodyFlag. Static
+    // bodies that are rebuilt, streamed or created in between therefore keep their key.
+    struct Contact
+    {
+        u32 bodyA{};
+        u32 fixtureA{};
+        u32 bodyB{};
+        u32 fixtureB{};
+        i32 childA{};
+        i32 childB{};
+        i32 pointCount{};
+        std::array<u32, 2> ids{};
+        std::array<float, 2> normalImpulses{};
+        std::array<float, 2> tangentImpulses{};
+
+        auto key() const { return std::tuple{bodyA, fixtureA, bodyB, fixtureB, childA, childB}; }
+    };
+
+    u64 tick() const { return header().tick; }
+    std::size_t bodyCount() const { return header().bodyCount; }
+    std::size_t contactCount() const { return header().contactCount; }
+    std::size_t sizeBytes() const { return mBuffer.size(); }
+
+private:
+    friend class Simulation;
+
+    struct Header
+    {
+        u64 tick{};
+        u32 bodyCount{};
+        // Sorted by Contact::key
+        u32 contactCount{};
+        u32 thrusterCount{};
+        u32 rectCount{};
+    };
+
+    Header header() const;
+
+    // Header, then bodies, contacts, u8 thruster states and rect poses back to back, copied in and out with memcpy
+    std::vector<std::byte> mBuffer;
+};
+
+struct StepTimings
+{
+    // Repairing edited tiles and streaming regions in and out
+    std::chrono::nanoseconds tileCollision{};
+    std::chrono::nanoseconds shipUpdate{};
+    std::chrono::nanoseconds animations{};
+    std::chrono::nanoseconds physics{};
+};
+
+// Game state advanced in fixed ticks. Identical levels, ships and input streams produce identical states, as time
+// is derived from the tick counter and nothing depends on the wall clock or window.
+class Simulation
+{
+public:
+    // With streaming, tile collision only exists around the ships and is loaded in the background. The order in
+    // which tile bodies are created then depends on the loader thread, so states are no longer bit reproducible.
+    Simulation(Level level, sf::Time fixedStep, std::optional<ChunkStreamer::Settings> streaming = std::nullopt);
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    Ship& addShip(sf::Color color, sf::Vector2f size, sf::Vector2f position = {}, sf::Angle angle = {});
+    const std::vector<ShipSpawn>& shipSpawns() const { return mShipSpawns; }
+
+    // Input for ships missing in input.ships keeps their previous thruster state
+    void step(const TickInput& input);
+    // Same as step, additionally measuring the duration of each phase
+    void step(const TickInput& input, StepTimings& timings);
+
+    // Hash over transforms and velocities of all non static bodies, used to detect diverging replays
+    u64 checksum() const;
+
+    // Overwrites state with the current state, reusing its storage
+    void save(SimulationState& state) const;
+    // Applies a newer version of the level between ticks, see Level::reload. Ships keep their state, states saved
+    // before a reload that changed the rect layout can no longer be restored.
+    Level::Changes reloadLevel(Level fresh);
+
+    // Rewinds to a state saved by this simulation. Box2D 2.4 keeps the sleep timer private, so bodies which were
+    // awake resume with a reset timer, and contacts that ended since saving start over without warm starting. Both
+    // only matter while bodies are close to falling asleep or in resting contact.
+    void restore(const SimulationState& state);
+
+    u64 tick() const { return mTick; }
+    sf::Time fixedStep() const { return mFixedStep; }
+    sf::Time gameTime() const { return mFixedStep * static_cast<i64>(mTick); }
+
+    // Poses at the start of the last step, for interpolating between the previous and the current tick. Empty
+    // before the first step.
+    const std::vector<Pose>& previousShipPoses() const { return mPreviousShipPoses; }
+    // One entry per Level::animatedRects
+    const std::vector<Pose>& previousRectPoses() const { return mPreviousRectPoses; }
+
+    b2World& world() { return mWorld; }
+    Level& level() { return mLevel; }
+    const Level& level() const { return mLevel; }
+    std::vector<Ship>& ships() { return mShips; }
+    const std::vector<Ship>& ships() const { return mShips; }
+    // Null unless streaming was enabled
+    const ChunkStreamer* chunkStreamer() const { return mChunkStreamer.get(); }
+
+private:
+    void step(const TickInput& input, StepTimings* timings);
+    void apply(const SimulationCommand& command);
+    // Fills mBodyKeys with every body of the world, sorted by address for bodyKey
+    void indexBodies() const;
+    // See SimulationState::Contact
+    u32 bodyKey(const b2Body* body) const;
+
+    sf::Time mFixedStep;
+    u64 mTick{};
+
+    b2World mWorld{{0.f, 0.f}};
+    Level mLevel;
+    std::vector<Ship> mShips;
+    std::vector<ShipSpawn> mShipSpawns;
+    // Applies thrust and drag of mShips, index for index
+    ShipSystem mShipSystem;
+
+    std::unique_ptr<ChunkStreamer> mChunkStreamer;
+    std::vector<sf::Vector2f> mFocusPoints;
+
+    std::vector<Pose> mPreviousShipPoses;
+    std::vector<Pose> mPreviousRectPoses;
+
+    // Scratch of save and restore, kept to avoid allocating
+    mutable std::vector<std::pair<const b2Body*, u32>> mBodyKeys;
+    mutable std::vector<SimulationState::Contact> mSavedContacts;
+};
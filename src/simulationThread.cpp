@@ -0,0 +1,145 @@
+#include "simulationThread.hpp"
+
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace
+{
+// Ticks the simulation may fall behind before it skips ahead instead of catching up, e.g. after a debugger break
+constexpr int maxCatchUpTicks = 5;
+} // namespace
+
+SimulationThread::SimulationThread(Simulation& simulation, TickCallback onTick) :
+    mSimulation{simulation},
+    mOnTick{std::move(onTick)},
+    mTickDuration{std::chrono::duration_cast<std::chrono::steady_clock::duration>(simulation.fixedStep().toDuration())}
+{
+    // Renderers keep their own copy of the tiles and catch up through RenderSnapshot::tileChanges
+    mSimulation.level().recordTileEdits(true);
+
+    // The render thread has a valid snapshot before the first tick
+    capture(mSimulation, mSnapshots.writeBuffer());
+    mSnapshots.writeBuffer().time = std::chrono::steady_clock::now();
+    mSnapshots.publish();
+
+    mThread = std::jthread([this](const std::stop_token& stopToken) { run(stopToken); });
+}
+
+SimulationThread::~SimulationThread()
+{
+    stop();
+}
+
+void SimulationThread::input(const TickInput& input)
+{
+    u64 packed{};
+    for (std::size_t ship = 0; ship < std::min(input.ships.size(), maxShips); ship++)
+    {
+        packed |= static_cast<u64>(input.ships[ship].thrusters & 0xF) << (ship * 4);
+    }
+
+    mInput.store(packed, std::memory_order_relaxed);
+}
+
+void SimulationThread::command(const SimulationCommand& command)
+{
+    std::scoped_lock lock(mCommandMutex);
+    mCommands.push_back(command);
+}
+
+const RenderSnapshot& SimulationThread::snapshot()
+{
+    mSnapshots.update();
+    return mSnapshots.readBuffer();
+}
+
+float SimulationThread::interpolationAlpha(const RenderSnapshot& snapshot) const
+{
+    auto sinceTick = std::chrono::steady_clock::now() - snapshot.time;
+    return std::clamp(std::chrono::duration<float>(sinceTick) / std::chrono::duration<float>(mTickDuration), 0.f, 1.f);
+}
+
+void SimulationThread::stop()
+{
+    if (mThread.joinable())
+    {
+        mThread.request_stop();
+        mThread.join();
+    }
+}
+
+void SimulationThread::run(const std::stop_token& stopToken)
+{
+    using Clock = std::chrono::steady_clock;
+
+    LUMIAX_THREAD_NAME("Simulation");
+
+    auto nextTick = Clock::now() + mTickDuration;
+
+    TickInput input;
+    input.ships.resize(std::min(mSimulation.ships().size(), maxShips));
+
+    while (!stopToken.stop_requested())
+    {
+        std::this_thread::sleep_until(nextTick);
+
+        u64 packed = mInput.load(std::memory_order_relaxed);
+        for (std::size_t ship = 0; ship < input.ships.size(); ship++)
+        {
+            input.ships[ship].thrusters = static_cast<u8>((packed >> (ship * 4)) & 0xF);
+        }
+
+        // Swapping keeps both vectors' storage, so queuing commands does not allocate once they have grown
+        input.commands.clear();
+        {
+            std::scoped_lock lock(mCommandMutex);
+            std::swap(input.commands, mCommands);
+        }
+
+        auto allocationsBefore = AllocationTracker::thread();
+        {
+            LUMIAX_ZONE("Tick");
+            std::scoped_lock lock(mSimulationMutex);
+            mSimulation.step(input);
+
+            if (mOnTick)
+                mOnTick(input, mSimulation);
+
+            LUMIAX_ZONE("Capture snapshot");
+            capture(mSimulation, mSnapshots.writeBuffer());
+            collectTileChanges(mSnapshots.writeBuffer());
+        }
+        mSnapshots.writeBuffer().tickAllocations = AllocationTracker::thread() - allocationsBefore;
+        mSnapshots.writeBuffer().time = nextTick;
+        mSnapshots.publish();
+
+        // Late ticks run back to back until the simulation caught up with the wall clock
+        nextTick = std::max(nextTick + mTickDuration, Clock::now() - (mTickDuration * maxCatchUpTicks));
+    }
+}
+
+void SimulationThread::collectTileChanges(RenderSnapshot& snapshot)
+{
+    auto& level = mSimulation.level();
+    // Changes queued before a reload were made to tiles that no longer exist
+    if (level.generation() != mTileGeneration)
+    {
+        mTileChanges.clear();
+        mTileGeneration = level.generation();
+    }
+
+    for (const auto& edit : level.tileEdits())
+        mTileChanges.push_back({mSimulation.tick(), edit});
+    level.clearTileEdits();
+
+    // Changes are repeated until the consumer applied a snapshot containing them
+    u64 acknowledged = mAcknowledgedTileTick.load(std::memory_order_relaxed);
+    auto applied = std::ranges::find_if(mTileChanges, [&](u64 tick) { return tick > acknowledged; }, &TileChange::tick);
+    mTileChanges.erase(mTileChanges.begin(), applied);
+
+    snapshot.tileChanges.assign(mTileChanges.begin(), mTileChanges.end());
+    snapshot.tileGeneration = mTileGeneration;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "renderSnapshot.hpp"
+#include "simulation.hpp"
+#include "tripleBuffer.hpp"
+#include "types.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Steps a Simulation at its fixed tick rate on a dedicated thread. Every tick publishes a RenderSnapshot, so the
+// render thread draws the latest completed tick without waiting for the simulation and vice versa.
+class SimulationThread
+{
+public:
+    // Called on the simulation thread after every step with the input that was applied
+    using TickCallback = std::function<void(const TickInput& input, const Simulation& simulation)>;
+
+    // Up to maxShips ships receive input, the thread starts immediately
+    static constexpr std::size_t maxShips = 16;
+
+    explicit SimulationThread(Simulation& simulation, TickCallback onTick = {});
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    // Input applied from the next tick on, callable from any thread
+    void input(const TickInput& input);
+    // Queues a command for the next tick, callable from any thread
+    void command(const SimulationCommand& command);
+
+    // Latest published snapshot, only call from a single consumer thread. The reference stays valid until the next
+    // call.
+    const RenderSnapshot& snapshot();
+
+    // Blend factor between the previous and current poses of snapshot for rendering at the current time. Rendering
+    // runs up to one tick behind the simulation in exchange for smooth motion at any display rate.
+    float interpolationAlpha(const RenderSnapshot& snapshot) const;
+
+    // Runs f with exclusive access to the simulation, blocking for at most one tick. For debug tooling that only
+    // reads, everything else should go through input, command and snapshot so recordings capture it.
+    template <typename Func>
+    void access(Func&& f)
+    {
+        std::scoped_lock lock(mSimulationMutex);
+        f(mSimulation);
+    }
+
+    // Called by the consumer once it applied the tile changes of the snapshot of tick, later snapshots leave them out
+    void acknowledgeTileChanges(u64 tick) { mAcknowledgedTileTick.store(tick, std::memory_order_relaxed); }
+
+    // Stops and joins the thread, the simulation is not stepped afterwards
+    void stop();
+
+private:
+    void run(const std::stop_token& stopToken);
+    // Moves the tile edits of the level into the pending changes and copies those into snapshot
+    void collectTileChanges(RenderSnapshot& snapshot);
+
+    Simulation& mSimulation;
+    TickCallback mOnTick;
+    std::chrono::steady_clock::duration mTickDuration;
+
+    // ShipInput::thrusters of up to maxShips ships, four bits each
+    std::atomic<u64> mInput{};
+    std::atomic<u64> mAcknowledgedTileTick{};
+    std::mutex mCommandMutex;
+    std::vector<SimulationCommand> mCommands;
+    // Tile changes not acknowledged yet and the level generation they belong to, only touched under
+    // mSimulationMutex
+    std::vector<TileChange> mTileChanges;
+    u64 mTileGeneration{};
+
+    std::mutex mSimulationMutex;
+    TripleBuffer<RenderSnapshot> mSnapshots;
+    std::jthread mThread;
+};
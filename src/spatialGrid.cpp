@@ -0,0 +1,57 @@
+#include "spatialGrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void SpatialGrid::insert(u32 item, sf::FloatRect bounds)
+{
+    auto min = cell(bounds.position);
+    auto max = cell(bounds.position + bounds.size);
+
+    for (int y = min.y; y <= max.y; y++)
+    {
+        for (int x = min.x; x <= max.x; x++)
+        {
+            mCells[key(x, y)].push_back(item);
+        }
+    }
+
+    mItemCount++;
+}
+
+void SpatialGrid::clear()
+{
+    mCells.clear();
+    mItemCount = 0;
+}
+
+void SpatialGrid::query(sf::FloatRect area, std::vector<u32>& result) const
+{
+    auto first = result.size();
+    auto min = cell(area.position);
+    auto max = cell(area.position + area.size);
+
+    for (int y = min.y; y <= max.y; y++)
+    {
+        for (int x = min.x; x <= max.x; x++)
+        {
+            if (auto found = mCells.find(key(x, y)); found != mCells.end())
+                result.insert(result.end(), found->second.begin(), found->second.end());
+        }
+    }
+
+    // Items spanning several cells are reported once per cell
+    auto begin = result.begin() + static_cast<std::ptrdiff_t>(first);
+    std::sort(begin, result.end());
+    result.erase(std::unique(begin, result.end()), result.end());
+}
+
+u64 SpatialGrid::key(int x, int y)
+{
+    return (static_cast<u64>(static_cast<u32>(x)) << 32) | static_cast<u32>(y);
+}
+
+sf::Vector2i SpatialGrid::cell(sf::Vector2f position) const
+{
+    return {static_cast<int>(std::floor(position.x / mCellSize)), static_cast<int>(std::floor(position.y / mCellSize))};
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <SFML/Graphics/Rect.hpp>
+#include <unordered_map>
+#include <vector>
+
+// Uniform grid over world space, items are referenced by the index they were inserted with
+class SpatialGrid
+{
+public:
+    explicit SpatialGrid(float cellSize) : mCellSize{cellSize} {}
+
+    void insert(u32 item, sf::FloatRect bounds);
+    void clear();
+
+    // Appends every item whose cells intersect area, sorted by item index and without duplicates
+    void query(sf::FloatRect area, std::vector<u32>& result) const;
+
+    std::size_t itemCount() const { return mItemCount; }
+
+private:
+    static u64 key(int x, int y);
+
+    sf::Vector2i cell(sf::Vector2f position) const;
+
+    float mCellSize{};
+    std::size_t mItemCount{};
+    std::unordered_map<u64, std::vector<u32>> mCells;
+};
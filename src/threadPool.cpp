@@ -0,0 +1,123 @@
+#include "threadPool.hpp"
+
+#include "profiler.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threadCount)
+{
+    threadCount = std::max(threadCount, 1u);
+
+    for (unsigned i = 0; i < threadCount; i++)
+        mQueues.push_back(std::make_unique<Queue>());
+
+    // Worker 0 is the thread calling parallelFor
+    for (std::size_t worker = 1; worker < threadCount; worker++)
+        mThreads.emplace_back([this, worker] { workerLoop(worker); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(mMutex);
+        mStop = true;
+    }
+    mWake.notify_all();
+
+    // Join before the members the workers use are destroyed
+    mThreads.clear();
+}
+
+void ThreadPool::parallelFor(std::size_t count, const std::function<void(std::size_t)>& task)
+{
+    if (count == 0)
+        return;
+
+    {
+        std::lock_guard lock(mMutex);
+
+        mTask = &task;
+        mRemaining = count;
+
+        for (std::size_t index = 0; index < count; index++)
+        {
+            auto& queue = *mQueues[index % mQueues.size()];
+            std::lock_guard queueLock(queue.mutex);
+            queue.indices.push_back(index);
+        }
+
+        mGeneration++;
+    }
+    mWake.notify_all();
+
+    runTasks(0);
+
+    std::unique_lock lock(mMutex);
+    mDone.wait(lock, [this] { return mRemaining == 0; });
+}
+
+void ThreadPool::workerLoop(std::size_t worker)
+{
+    LUMIAX_THREAD_NAME("Worker");
+
+    unsigned long long seenGeneration = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock lock(mMutex);
+            mWake.wait(lock, [&] { return mStop || mGeneration != seenGeneration; });
+
+            if (mStop)
+                return;
+
+            seenGeneration = mGeneration;
+        }
+
+        runTasks(worker);
+    }
+}
+
+void ThreadPool::runTasks(std::size_t worker)
+{
+    std::size_t index{};
+    while (pop(worker, index))
+    {
+        (*mTask)(index);
+
+        if (mRemaining.fetch_sub(1) == 1)
+        {
+            // Taking the lock orders the notification after the waiting thread checked mRemaining
+            std::lock_guard lock(mMutex);
+            mDone.notify_all();
+        }
+    }
+}
+
+bool ThreadPool::pop(std::size_t worker, std::size_t& index)
+{
+    {
+        auto& own = *mQueues[worker];
+        std::lock_guard lock(own.mutex);
+        if (!own.indices.empty())
+        {
+            index = own.indices.front();
+            own.indices.pop_front();
+            return true;
+        }
+    }
+
+    for (std::size_t offset = 1; offset < mQueues.size(); offset++)
+    {
+        auto& victim = *mQueues[(worker + offset) % mQueues.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.indices.empty())
+        {
+            index = victim.indices.back();
+            victim.indices.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers executing index ranges. Indices are dealt round robin into per worker queues, a worker that
+// runs out of work steals from the back of the other queues.
+class ThreadPool
+{
+public:
+    // threadCount includes the calling thread, which takes part in every parallelFor
+    explicit ThreadPool(unsigned threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Runs task(index) for every index in [0, count) and returns once all of them finished
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)>& task);
+
+    unsigned threadCount() const { return static_cast<unsigned>(mQueues.size()); }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::size_t> indices;
+    };
+
+    void workerLoop(std::size_t worker);
+    void runTasks(std::size_t worker);
+    bool pop(std::size_t worker, std::size_t& index);
+
+    std::vector<std::unique_ptr<Queue>> mQueues;
+    std::vector<std::jthread> mThreads;
+
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::condition_variable mDone;
+    unsigned long long mGeneration{};
+    bool mStop{};
+
+    const std::function<void(std::size_t)>* mTask{};
+    std::atomic<std::size_t> mRemaining{};
+};
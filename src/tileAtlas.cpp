@@ -0,0 +1,159 @@
+#include "tileAtlas.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#include <cmath>
+
+namespace
+{
+constexpr std::size_t bytesPerPixel = 4;
+
+struct Placement
+{
+    const Level::Tileset* tileset{};
+    u32 tile{};
+    // Top left of the tile inside its padding
+    sf::Vector2u position;
+};
+
+u32 tileCount(const Level::Tileset& tileset)
+{
+    if (tileset.columns == 0 || tileset.tileDim.x == 0 || tileset.tileDim.y == 0)
+        return 0;
+    // Loaders reject these, copyTile would read past the image rows
+    if (u64{tileset.columns} * tileset.tileDim.x > tileset.image.getSize().x)
+        return 0;
+
+    return tileset.columns * (tileset.image.getSize().y / tileset.tileDim.y);
+}
+
+void copyTile(const Placement& placement, std::vector<u8>& pixels, u32 width)
+{
+    const auto& tileset = *placement.tileset;
+    const u8* source = tileset.image.getPixelsPtr();
+    std::size_t sourceWidth = tileset.image.getSize().x;
+    std::size_t sourceX = (placement.tile % tileset.columns) * tileset.tileDim.x;
+    std::size_t sourceY = (placement.tile / tileset.columns) * tileset.tileDim.y;
+
+    for (std::size_t y = 0; y < tileset.tileDim.y; y++)
+    {
+        std::copy_n(source + ((((sourceY + y) * sourceWidth) + sourceX) * bytesPerPixel),
+                    tileset.tileDim.x * bytesPerPixel,
+                    pixels.data() + ((((placement.position.y + y) * width) + placement.position.x) * bytesPerPixel));
+    }
+}
+
+void extrude(const Placement& placement, std::vector<u8>& pixels, u32 width)
+{
+    constexpr std::size_t padding = TileAtlas::padding;
+    auto pixel = [&](std::size_t x, std::size_t y) { return pixels.data() + (((y * width) + x) * bytesPerPixel); };
+
+    std::size_t left = placement.position.x;
+    std::size_t top = placement.position.y;
+    std::size_t right = left + placement.tileset->tileDim.x - 1;
+    std::size_t bottom = top + placement.tileset->tileDim.y - 1;
+
+    // Columns first, extruding the rows afterwards copies the columns into the corners as well
+    for (std::size_t y = top; y <= bottom; y++)
+    {
+        for (std::size_t offset = 1; offset <= padding; offset++)
+        {
+            std::copy_n(pixel(left, y), bytesPerPixel, pixel(left - offset, y));
+            std::copy_n(pixel(right, y), bytesPerPixel, pixel(right + offset, y));
+        }
+    }
+
+    std::size_t rowBytes = (right - left + 1 + (2 * padding)) * bytesPerPixel;
+    for (std::size_t offset = 1; offset <= padding; offset++)
+    {
+        std::copy_n(pixel(left - padding, top), rowBytes, pixel(left - padding, top - offset));
+        std::copy_n(pixel(left - padding, bottom), rowBytes, pixel(left - padding, bottom + offset));
+    }
+}
+} // namespace
+
+TileAtlas::TileAtlas(std::span<const Level::Tileset> tilesets)
+{
+    std::size_t area = 0;
+    u32 widestCell = 1;
+    u32 gidCount = 0;
+    for (const auto& tileset : tilesets)
+    {
+        u32 count = tileCount(tileset);
+        if (count == 0)
+            continue;
+
+        sf::Vector2u cell = tileset.tileDim + sf::Vector2u{2 * padding, 2 * padding};
+        area += static_cast<std::size_t>(count) * cell.x * cell.y;
+        widestCell = std::max(widestCell, cell.x);
+        gidCount = std::max(gidCount, tileset.firstGid + count);
+    }
+
+    // Roughly square, shelves of tiles in tileset order
+    u32 width = std::max(widestCell, std::bit_ceil(static_cast<u32>(std::ceil(std::sqrt(static_cast<double>(area))))));
+    std::vector<Placement> placements;
+    sf::Vector2u cursor;
+    u32 shelfHeight = 0;
+    for (const auto& tileset : tilesets)
+    {
+        sf::Vector2u cell = tileset.tileDim + sf::Vector2u{2 * padding, 2 * padding};
+        for (u32 tile = 0; tile < tileCount(tileset); tile++)
+        {
+            if (cursor.x + cell.x > width)
+            {
+                cursor = {0, cursor.y + shelfHeight};
+                shelfHeight = 0;
+            }
+
+            placements.push_back({&tileset, tile, cursor + sf::Vector2u{padding, padding}});
+            cursor.x += cell.x;
+            shelfHeight = std::max(shelfHeight, cell.y);
+        }
+    }
+    u32 height = std::max(cursor.y + shelfHeight, 1u);
+
+    std::vector<u8> pixels(static_cast<std::size_t>(width) * height * bytesPerPixel);
+    mRects.resize(gidCount);
+    for (const auto& placement : placements)
+    {
+        copyTile(placement, pixels, width);
+        extrude(placement, pixels, width);
+
+        mRects[placement.tileset->firstGid + placement.tile] = {sf::Vector2i(placement.position),
+                                                                sf::Vector2i(placement.tileset->tileDim)};
+    }
+
+    mImage = sf::Image({width, height}, pixels.data());
+
+    // Animations whose frames are not all in the atlas, or that take no time at all, stay on their own tile
+    mAnimationIndices.assign(gidCount, notAnimated);
+    for (const auto& tileset : tilesets)
+    {
+        for (const auto& tileAnimation : tileset.animations)
+        {
+            Animation animation;
+            animation.gid = tileset.firstGid + tileAnimation.tile;
+            u32 end = 0;
+            for (auto frame : tileAnimation.frames)
+            {
+                end += frame.durationMs;
+                animation.frames.push_back(rect(tileset.firstGid + frame.tile));
+                animation.frameEnds.push_back(end);
+            }
+
+            auto inAtlas = [](const sf::IntRect& frame) { return frame.size.x > 0; };
+            if (animation.gid >= gidCount || end == 0 || !std::ranges::all_of(animation.frames, inAtlas))
+                continue;
+
+            mAnimationIndices[animation.gid] = static_cast<u32>(mAnimations.size());
+            mAnimations.push_back(std::move(animation));
+        }
+    }
+}
+
+u32 TileAtlas::Animation::frameAt(u32 timeMs) const
+{
+    u32 cycleTime = timeMs % frameEnds.back();
+    return static_cast<u32>(std::ranges::upper_bound(frameEnds, cycleTime) - frameEnds.begin());
+}
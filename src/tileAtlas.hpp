@@ -0,0 +1,61 @@
+#pragma once
+
+#include "level.hpp"
+#include "types.hpp"
+
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/Graphics/Rect.hpp>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Every tile of every tileset packed into one image, so all tiles draw with a single texture. Each tile is
+// surrounded by copies of its own edge pixels, sampling just outside a tile at non-integer zoom then picks up the
+// tile's own colors instead of those of its neighbour. The padding only covers the full resolution image, so the
+// atlas is sampled without mip maps.
+class TileAtlas
+{
+public:
+    // Extruded pixels on each side of a tile
+    static constexpr u32 padding = 2;
+
+    // Tiled tile animation resolved to atlas rects
+    struct Animation
+    {
+        u32 gid{};
+        std::vector<sf::IntRect> frames;
+        // Milliseconds into the cycle at which each frame ends, the last one is the length of the cycle
+        std::vector<u32> frameEnds;
+
+        // Frame shown at a time in milliseconds, animations loop from time 0 on
+        u32 frameAt(u32 timeMs) const;
+    };
+
+    TileAtlas() = default;
+    explicit TileAtlas(std::span<const Level::Tileset> tilesets);
+
+    const sf::Image& image() const { return mImage; }
+
+    // Texture rect of a global tile id without flip flags, empty for ids no tileset covers
+    sf::IntRect rect(u32 gid) const { return gid < mRects.size() ? mRects[gid] : sf::IntRect{}; }
+
+    const std::vector<Animation>& animations() const { return mAnimations; }
+    // Index into animations of an animated global tile id
+    std::optional<u32> animation(u32 gid) const
+    {
+        if (gid >= mAnimationIndices.size() || mAnimationIndices[gid] == notAnimated)
+            return {};
+
+        return mAnimationIndices[gid];
+    }
+
+private:
+    static constexpr u32 notAnimated = std::numeric_limits<u32>::max();
+
+    sf::Image mImage;
+    // Indexed by global tile id
+    std::vector<sf::IntRect> mRects;
+    std::vector<u32> mAnimationIndices;
+    std::vector<Animation> mAnimations;
+};
@@ -0,0 +1,253 @@
+#include "tileDecoder.hpp"
+
+#include <zlib.h>
+#ifdef LUMIAX_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <format>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define LUMIAX_BASE64_SSSE3
+#include <tmmintrin.h>
+#endif
+
+namespace TileDecoder
+{
+namespace
+{
+constexpr u8 invalid = 0xff;
+
+constexpr std::array<u8, 256> decodeTable = []
+{
+    std::array<u8, 256> table{};
+    table.fill(invalid);
+
+    constexpr std::string_view alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (std::size_t i = 0; i < alphabet.size(); i++)
+        table[static_cast<u8>(alphabet[i])] = static_cast<u8>(i);
+
+    return table;
+}();
+
+// Decodes whole groups of four characters, returns false on an invalid character
+bool decodeScalar(const char*& in, const char* end, u8*& out)
+{
+    for (; in + 4 <= end; in += 4, out += 3)
+    {
+        u32 a = decodeTable[static_cast<u8>(in[0])];
+        u32 b = decodeTable[static_cast<u8>(in[1])];
+        u32 c = decodeTable[static_cast<u8>(in[2])];
+        u32 d = decodeTable[static_cast<u8>(in[3])];
+
+        if (((a | b | c | d) & 0x80u) != 0)
+            return false;
+
+        u32 bits = (a << 18) | (b << 12) | (c << 6) | d;
+        out[0] = static_cast<u8>(bits >> 16);
+        out[1] = static_cast<u8>(bits >> 8);
+        out[2] = static_cast<u8>(bits);
+    }
+
+    return true;
+}
+
+#ifdef LUMIAX_BASE64_SSSE3
+#if defined(__GNUC__)
+#define LUMIAX_TARGET_SSSE3 __attribute__((target("ssse3")))
+#else
+#define LUMIAX_TARGET_SSSE3
+#endif
+
+bool hasSsse3()
+{
+#if defined(__GNUC__)
+    static const bool supported = __builtin_cpu_supports("ssse3") != 0;
+    return supported;
+#else
+    return true;
+#endif
+}
+
+// Classifies 16 characters at once by their nibbles, converts them with one add per byte and packs the 6 bit values
+// into 12 bytes. Each step stores 16 bytes, so it stops early enough for the scalar loop to write the last ones.
+LUMIAX_TARGET_SSSE3 bool decodeSsse3(const char*& in, const char* end, u8*& out, const u8* outEnd)
+{
+    const __m128i lutLo =
+        _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lutHi =
+        _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i nibbleMask = _mm_set1_epi8(0x0f);
+    const __m128i slash = _mm_set1_epi8('/');
+    const __m128i packPairs = _mm_set1_epi32(0x01400140);
+    const __m128i packQuads = _mm_set1_epi32(0x00011000);
+    const __m128i packBytes = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    while (in + 16 <= end && out + 16 <= outEnd)
+    {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+        __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(chars, 4), nibbleMask);
+        __m128i loNibbles = _mm_and_si128(chars, nibbleMask);
+
+        __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+        __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xffff)
+            return false;
+
+        // '/' shares its high nibble with '+', shifting its index selects its own offset
+        __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(_mm_cmpeq_epi8(chars, slash), hiNibbles));
+        __m128i values = _mm_add_epi8(chars, roll);
+
+        __m128i pairs = _mm_maddubs_epi16(values, packPairs);
+        __m128i quads = _mm_madd_epi16(pairs, packQuads);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(quads, packBytes));
+
+        in += 16;
+        out += 12;
+    }
+
+    return true;
+}
+#endif
+
+std::optional<std::string> inflateInto(std::span<const u8> compressed, std::span<u8> out)
+{
+    z_stream stream{};
+    // 32 enables automatic detection of the zlib and gzip headers
+    if (inflateInit2(&stream, 15 + 32) != Z_OK)
+        return "Could not initialize zlib";
+
+    stream.next_in = const_cast<Bytef*>(compressed.data());
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    stream.next_out = out.data();
+    stream.avail_out = static_cast<uInt>(out.size());
+
+    int result = inflate(&stream, Z_FINISH);
+    bool complete = result == Z_STREAM_END && stream.total_out == out.size();
+    inflateEnd(&stream);
+
+    if (!complete)
+        return std::format("Corrupt or mis-sized compressed chunk data (zlib result {})", result);
+
+    return {};
+}
+} // namespace
+
+std::expected<Compression, std::string> parseCompression(std::string_view name)
+{
+    if (name.empty())
+        return Compression::None;
+    if (name == "zlib")
+        return Compression::Zlib;
+    if (name == "gzip")
+        return Compression::Gzip;
+    if (name == "zstd")
+        return Compression::Zstd;
+
+    return std::unexpected(std::format("Unsupported tile layer compression: {}", name));
+}
+
+std::size_t decodedSize(std::string_view text)
+{
+    std::size_t padding = 0;
+    while (padding < 2 && padding < text.size() && text[text.size() - 1 - padding] == '=')
+        padding++;
+
+    std::size_t chars = text.size() - padding;
+    return ((chars / 4) * 3) + ((chars % 4) * 3 / 4);
+}
+
+std::optional<std::size_t> decodeBase64(std::string_view text, std::span<u8> out)
+{
+    while (!text.empty() && text.back() == '=')
+        text.remove_suffix(1);
+
+    std::size_t size = decodedSize(text);
+    if (size > out.size() || text.size() % 4 == 1)
+        return std::nullopt;
+
+    const char* in = text.data();
+    const char* end = text.data() + text.size();
+    u8* outPos = out.data();
+
+#ifdef LUMIAX_BASE64_SSSE3
+    if (hasSsse3() && !decodeSsse3(in, end, outPos, out.data() + out.size()))
+        return std::nullopt;
+#endif
+
+    if (!decodeScalar(in, end, outPos))
+        return std::nullopt;
+
+    // Two or three characters left after stripping the padding
+    if (in != end)
+    {
+        std::array<char, 4> tail{'A', 'A', 'A', 'A'};
+        std::copy(in, end, tail.begin());
+        std::array<u8, 3> bytes{};
+
+        const char* tailIn = tail.data();
+        u8* tailOut = bytes.data();
+        if (!decodeScalar(tailIn, tail.data() + tail.size(), tailOut))
+            return std::nullopt;
+
+        auto remaining = static_cast<std::size_t>(end - in) - 1;
+        std::copy_n(bytes.begin(), remaining, outPos);
+    }
+
+    return size;
+}
+
+std::optional<std::string> decode(std::string_view base64,
+                                  Compression compression,
+                                  std::span<u32> tiles,
+                                  std::vector<u8>& scratch)
+{
+    auto tileBytes = std::as_writable_bytes(tiles);
+    std::span<u8> out(reinterpret_cast<u8*>(tileBytes.data()), tileBytes.size());
+
+    if (compression == Compression::None)
+    {
+        auto size = decodedSize(base64);
+        if (size != out.size())
+            return std::format("Chunk data decodes to {} bytes instead of {}", size, out.size());
+
+        if (!decodeBase64(base64, out).has_value())
+            return "Invalid base64 in chunk data";
+    }
+    else
+    {
+        scratch.resize(decodedSize(base64));
+        auto decoded = decodeBase64(base64, scratch);
+        if (!decoded.has_value())
+            return "Invalid base64 in chunk data";
+        std::span<const u8> compressed(scratch.data(), *decoded);
+
+        if (compression == Compression::Zstd)
+        {
+#ifdef LUMIAX_HAS_ZSTD
+            std::size_t result = ZSTD_decompress(out.data(), out.size(), compressed.data(), compressed.size());
+            if (ZSTD_isError(result) != 0 || result != out.size())
+                return "Corrupt or mis-sized zstd chunk data";
+#else
+            return "Level uses zstd compression, but this build has no zstd support";
+#endif
+        }
+        else if (auto error = inflateInto(compressed, out); error.has_value())
+        {
+            return error;
+        }
+    }
+
+    if constexpr (std::endian::native == std::endian::big)
+    {
+        for (auto& tile : tiles)
+            tile = std::byteswap(tile);
+    }
+
+    return {};
+}
+} // namespace TileDecoder
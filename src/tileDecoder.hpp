@@ -0,0 +1,39 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <expected>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Decoding of Tiled's base64 tile layer data, optionally compressed with zlib, gzip or zstd
+namespace TileDecoder
+{
+enum class Compression : u8
+{
+    None,
+    Zlib,
+    Gzip,
+    Zstd
+};
+
+// Parses the "compression" property of a tile layer, an empty name means uncompressed
+std::expected<Compression, std::string> parseCompression(std::string_view name);
+
+// Number of bytes text decodes to, including the effect of padding
+std::size_t decodedSize(std::string_view text);
+
+// Decodes standard base64 with optional padding into out. Returns the number of bytes written, or nothing if text
+// contains invalid characters or out is too small.
+std::optional<std::size_t> decodeBase64(std::string_view text, std::span<u8> out);
+
+// Decodes one chunk into tiles, which must already have the chunk's size. The data has to decode to exactly that
+// many little endian tile ids. scratch holds compressed bytes and is reused between calls.
+std::optional<std::string> decode(std::string_view base64,
+                                  Compression compression,
+                                  std::span<u32> tiles,
+                                  std::vector<u8>& scratch);
+} // namespace TileDecoder
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <array>
+#include <atomic>
+
+// Single producer, single consumer hand over of the latest value without locks. The producer fills writeBuffer()
+// and publishes it, the consumer picks up the most recently published buffer with update(). Neither side ever
+// waits, values published in between two updates are skipped.
+template <typename T>
+class TripleBuffer
+{
+public:
+    // Producer side
+    T& writeBuffer() { return mBuffers[mBack]; }
+    void publish() { mBack = mMiddle.exchange(mBack | newDataBit, std::memory_order_acq_rel) & indexMask; }
+
+    // Consumer side, returns true if a newer buffer became the read buffer
+    bool update()
+    {
+        if ((mMiddle.load(std::memory_order_relaxed) & newDataBit) == 0)
+            return false;
+
+        mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+    const T& readBuffer() const { return mBuffers[mFront]; }
+
+private:
+    static constexpr u8 indexMask = 0x3;
+    static constexpr u8 newDataBit = 0x4;
+
+    std::array<T, 3> mBuffers{};
+    u8 mBack{0};
+    u8 mFront{1};
+    std::atomic<u8> mMiddle{2};
+};